@@ -8,6 +8,9 @@
 % varrate is the estimated instantaneous variance in the discharge rate (incl. refractoriness)
 % psth is the peri-stimulus time histogram 
 %
+% Only the requested outputs are computed: [meanrate,varrate] = model_Synapse(...) does not run
+% the spike generator, and meanrate = model_Synapse(...) also skips the variance.
+%
 % pin is the input sound wave in Pa sampled at the appropriate sampling rate (see instructions below)
 % CF is the characteristic frequency of the fiber in Hz
 % nrep is the number of repetitions for the mean rate, rate variance & psth calculation
@@ -33,5 +36,49 @@
 % functions in the synapse model.
 %
 %
+% CHECKPOINTED SEGMENTS:-
+% A long stimulus can be run in consecutive segments, with the state of the model
+% returned at the end of each segment and passed back in with the next one:
+%
+%    [vihc,ihcstate] = model_IHC(pin,CF,1,tdres,reptime,cohc,cihc,species,ihcstate);
+%    [meanrate,varrate,psth,synstate] = model_Synapse(vihc,CF,1,tdres,fiberType,noiseType,implnt,synstate);
+%
+% nrep must be 1.  ihcstate is [] for the first segment, and reptime is the duration of the
+% segment.  For the first segment synstate is the total number of samples of the whole
+% IHC output.  The synapse output lags its input, so each call returns the next
+% length(meanrate) samples of the response and the remainder is returned with the last
+% segment.  The states are uint8 arrays that can also be saved to resume an interrupted
+% simulation; the segmented responses are identical to those of a single run.
+%
+% MANY FIBERS PER CF:-
+% Fibers of one CF with any spontaneous rates can be run on the same IHC output in one pass:
+%
+%    [meanrate,varrate,psth] = model_SynapseBank(vihc,CF,nrep,tdres,spont,noiseType,implnt);
+%
+% spont is a vector of spontaneous rates in spikes/s (e.g. [0.1 4 100 100 100]), and row i of
+% the outputs is the response of the fiber of rate spont(i).  Fibers of the same rate share
+% the first stages of the synapse and differ only in their fGn.
+%
+% MANY SHORT STIMULI:-
+% A list of stimuli of any lengths can be run through one fiber in one call, as model_IHC
+% followed by model_Synapse would with nrep = 1 and reptime the duration of each stimulus:
+%
+%    [meanrate,varrate,psth] = model_Batch(stims,CF,tdres,cohc,cihc,species,fiberType,noiseType,implnt);
+%
+% stims is a cell array of row vectors in Pa.  The responses are packed back to back: with
+% off = [0 cumsum(cellfun(@numel,stims))], the response to stims{s} is
+% meanrate(off(s)+1:off(s+1)).  Each stimulus has its own fGn and spikes.
+%
+% SWEEPS OF CIHC:-
+% cihc only scales the input of the IHC, so the IHC potential for many values of cihc can be
+% computed in one call, which runs the middle ear, the control path and the C1 and C2 filters
+% once:
+%
+%    vihc = model_IHC(pin,CF,nrep,tdres,reptime,cohc,[1 0.8 0.6 0.4 0.2],species);
+%
+% Row k of vihc is the IHC potential for cihc(k), which can be passed to model_Synapse.  The
+% rows are those of separate calls (up to 1e-12 V in the silence that follows a stimulus).
+% A vector of cihc cannot be used with checkpointed segments.
+%
 % NOTE ON SAMPLING RATE:-
 % Since version 4 of the code, the model should be run at a sampling rates of 100 kHz
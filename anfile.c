@@ -0,0 +1,58 @@
+/*
+anfile.c maps the stimulus and output files of the native programs into memory, and parses
+the sizes given on their command lines
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "anmodel.h"
+#include "anfile.h"
+
+int ANMapRead(ANMAP *m, const char *path)
+{
+    struct stat sb;
+
+    m->data = NULL; m->size = 0;
+    m->fd = open(path, O_RDONLY);
+    if (m->fd<0) return(AN_EIO);
+    if (fstat(m->fd, &sb)!=0 || sb.st_size==0) { close(m->fd); m->fd = -1; return(AN_EIO); }
+    m->size = (size_t)sb.st_size;
+    m->data = mmap(NULL, m->size, PROT_READ, MAP_SHARED, m->fd, 0);
+    if (m->data==MAP_FAILED) { m->data = NULL; close(m->fd); m->fd = -1; return(AN_EIO); }
+#ifdef MADV_SEQUENTIAL
+    madvise(m->data, m->size, MADV_SEQUENTIAL);
+#endif
+    return(AN_OK);
+}
+
+int ANMapWrite(ANMAP *m, const char *path, size_t size)
+{
+    m->data = NULL; m->size = size;
+    m->fd = open(path, O_RDWR|O_CREAT|O_TRUNC, 0666);
+    if (m->fd<0) return(AN_EIO);
+    if (ftruncate(m->fd, (off_t)size)!=0) { close(m->fd); m->fd = -1; return(AN_EIO); }
+    m->data = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, m->fd, 0);
+    if (m->data==MAP_FAILED) { m->data = NULL; close(m->fd); m->fd = -1; return(AN_EIO); }
+    return(AN_OK);
+}
+
+void ANMapClose(ANMAP *m)
+{
+    if (m->data!=NULL) munmap(m->data, m->size);
+    if (m->fd>=0) close(m->fd);
+    m->data = NULL; m->fd = -1;
+}
+
+size_t ANParseBytes(const char *s)
+{
+    char  *end;
+    double b = strtod(s, &end);
+
+    if (*end=='k' || *end=='K') { b *= 1024; end++; }
+    else if (*end=='M')         { b *= 1048576; end++; }
+    else if (*end=='G')         { b *= 1073741824.0; end++; }
+    return((*end || b<1) ? 0 : (size_t)b);
+}
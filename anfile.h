@@ -0,0 +1,30 @@
+#ifndef _ANFILE_H
+#define _ANFILE_H
+
+/* ANFILE.H header file
+ * memory-mapped input and output files (POSIX), so that the stimulus is read and the
+ * neurogram written in place, without copies through intermediate buffers
+ * (and the byte counts given on the command lines of the native programs)
+*/
+
+#include <stddef.h>
+
+typedef struct __ANMAP
+{
+    void   *data;
+    size_t  size;
+    int     fd;
+} ANMAP;
+
+/* Map an existing file read-only, with sequential read-ahead */
+int  ANMapRead(ANMAP *m, const char *path);
+/* Create (or truncate) a file of size bytes and map it for writing; the pages are
+   shared, so the writes of forked workers go straight to the file */
+int  ANMapWrite(ANMAP *m, const char *path, size_t size);
+void ANMapClose(ANMAP *m);
+
+/* A number of bytes given on a command line, with an optional k, M or G suffix
+   (0 if it is not one) */
+size_t ANParseBytes(const char *s);
+
+#endif
@@ -0,0 +1,209 @@
+/*
+anmodel.c includes the error messages, random-number generator and checkpoint blobs
+shared by the native parts of the model
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "anmodel.h"
+
+#define AN_BLOB_VERSION 1u
+
+const char *ANErrorMessage(int err)
+{
+    switch (err)
+    {
+        case AN_OK:        return "No error.\n";
+        case AN_ENOMEM:    return "Out of memory.\n";
+        case AN_EUNSTABLE: return "The poles are in the right-half plane; system is unstable.\n";
+        case AN_EZEROS:    return "The zeros are in the right-half plane.\n";
+        case AN_EPARAM:    return "Invalid model parameter.\n";
+        case AN_ESTATE:    return "The checkpoint is corrupt or belongs to a different model fiber.\n";
+        case AN_EFGN:      return "The fast Fourier transform of the circulant covariance had negative values.\n";
+        case AN_EWORKER:   return "A worker process failed repeatedly.\n";
+        case AN_EIO:       return "A file could not be opened or mapped.\n";
+    }
+    return "Unknown error.\n";
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Random numbers */
+
+void ANRandSeed(ANRAND *rng, uint64_t seed)
+{
+    rng->s = seed;
+    rng->havespare = 0;
+    rng->spare = 0.0;
+}
+
+static uint64_t ANRandNext(ANRAND *rng)
+{
+    uint64_t z = (rng->s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double ANRandUniform(ANRAND *rng)
+{
+    /* 53 random bits, offset by half a step so that 0 and 1 are never returned */
+    return ((double)(ANRandNext(rng) >> 11) + 0.5) * (1.0/9007199254740992.0);
+}
+
+double ANRandNormal(ANRAND *rng)
+{
+    double u, v, s;
+
+    if (rng->havespare)
+    {
+        rng->havespare = 0;
+        return rng->spare;
+    }
+    do
+    {
+        u = 2.0*ANRandUniform(rng) - 1.0;
+        v = 2.0*ANRandUniform(rng) - 1.0;
+        s = u*u + v*v;
+    } while (s >= 1.0);
+    s = sqrt(-2.0*log(s)/s);
+    rng->spare     = v*s;
+    rng->havespare = 1;
+    return u*s;
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Checkpoint blobs */
+
+void ANBlobInit(ANBLOB *blob)
+{
+    memset(blob, 0, sizeof(ANBLOB));
+}
+
+void ANBlobWrap(ANBLOB *blob, const void *data, size_t size)
+{
+    ANBlobInit(blob);
+    blob->data = (unsigned char *)data;
+    blob->size = size;
+    blob->cap  = 0;  /* cap==0 marks a view that is not owned by the blob */
+}
+
+void ANBlobFree(ANBLOB *blob)
+{
+    if (blob->cap) free(blob->data);
+    ANBlobInit(blob);
+}
+
+void ANBlobPut(ANBLOB *blob, const void *src, size_t n)
+{
+    unsigned char *tmp;
+    size_t newcap;
+
+    if (blob->err) return;
+    if (blob->size+n > blob->cap)
+    {
+        newcap = __max(2*blob->cap, blob->size+n+256);
+        tmp = (unsigned char *)realloc(blob->cap ? blob->data : NULL, newcap);
+        if (tmp==NULL) { blob->err = AN_ENOMEM; return; }
+        blob->data = tmp;
+        blob->cap  = newcap;
+    }
+    memcpy(blob->data+blob->size, src, n);
+    blob->size += n;
+}
+
+void ANBlobGet(ANBLOB *blob, void *dst, size_t n)
+{
+    if (blob->err) return;
+    if (blob->pos+n > blob->size) { blob->err = AN_ESTATE; return; }
+    memcpy(dst, blob->data+blob->pos, n);
+    blob->pos += n;
+}
+
+void ANBlobPutHeader(ANBLOB *blob, uint32_t tag, uint32_t size)
+{
+    uint32_t hdr[3];
+
+    hdr[0] = tag; hdr[1] = AN_BLOB_VERSION; hdr[2] = size;
+    ANBlobPut(blob, hdr, sizeof(hdr));
+}
+
+int ANBlobCheckHeader(ANBLOB *blob, uint32_t tag, uint32_t size)
+{
+    uint32_t hdr[3];
+
+    ANBlobGet(blob, hdr, sizeof(hdr));
+    if (blob->err) return blob->err;
+    if (hdr[0]!=tag || hdr[1]!=AN_BLOB_VERSION || hdr[2]!=size) blob->err = AN_ESTATE;
+    return blob->err;
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Workspace arena */
+
+void ANWorkInit(ANWORK *w)
+{
+    memset(w, 0, sizeof(ANWORK));
+}
+
+int ANWorkReserve(ANWORK *w, size_t size)
+{
+    void *p;
+
+    size = ANWorkRound(size);
+    if (size<=w->size) return(AN_OK);
+    if (w->used>0) return(AN_EPARAM);
+    /* malloc rather than realloc: the old contents are not needed */
+    p = malloc(size+AN_WORK_ALIGN);
+    if (p==NULL) return(AN_ENOMEM);
+    free(w->base);
+    w->base = (unsigned char*)p;
+    w->size = size;
+    return(AN_OK);
+}
+
+void ANWorkFree(ANWORK *w)
+{
+    free(w->base);
+    ANWorkInit(w);
+}
+
+void *ANWorkAlloc(ANWORK *w, size_t n)
+{
+    unsigned char *p;
+    size_t off;
+
+    if (w==NULL) return(malloc(n>0 ? n : 1));
+    /* offsets are aligned from the first aligned address of the block */
+    p   = w->base + ((AN_WORK_ALIGN - (size_t)w->base % AN_WORK_ALIGN) % AN_WORK_ALIGN);
+    off = w->used;
+    if (w->base==NULL || ANWorkRound(n) > w->size-off) return(NULL);
+    w->used += ANWorkRound(n);
+    if (w->used>w->peak) w->peak = w->used;
+    return(p+off);
+}
+
+void *ANWorkCalloc(ANWORK *w, size_t n)
+{
+    void *p;
+
+    if (w==NULL) return(calloc(n>0 ? n : 1, 1));
+    p = ANWorkAlloc(w, n);
+    if (p!=NULL) memset(p, 0, n);
+    return(p);
+}
+
+void ANWorkRelease(ANWORK *w, void *p)
+{
+    if (w==NULL) free(p);
+}
+
+size_t ANWorkMark(const ANWORK *w)
+{
+    return((w==NULL) ? 0 : w->used);
+}
+
+void ANWorkReset(ANWORK *w, size_t mark)
+{
+    if (w!=NULL && mark<=w->used) w->used = mark;
+}
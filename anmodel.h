@@ -0,0 +1,98 @@
+#ifndef _ANMODEL_H
+#define _ANMODEL_H
+
+/* ANMODEL.H header file
+ * common definitions for the native (MATLAB-independent) parts of the AN model:
+ * error codes, the random-number generator and the binary blobs used for checkpoints
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TWOPI
+#define TWOPI 6.28318530717959
+#endif
+
+#ifndef __max
+#define __max(a,b) (((a) > (b))? (a): (b))
+#endif
+
+#ifndef __min
+#define __min(a,b) (((a) < (b))? (a): (b))
+#endif
+
+/* Error codes returned by the model functions (0 means success) */
+#define AN_OK          0
+#define AN_ENOMEM     -1   /* out of memory */
+#define AN_EUNSTABLE  -2   /* poles of a chirp filter in the right-half plane */
+#define AN_EZEROS     -3   /* zeros of a chirp filter in the right-half plane */
+#define AN_EPARAM     -4   /* invalid parameter */
+#define AN_ESTATE     -5   /* corrupt checkpoint or checkpoint of a different fiber */
+#define AN_EFGN       -6   /* negative circulant covariance in the fGn generator */
+#define AN_EWORKER    -7   /* a worker process failed repeatedly */
+#define AN_EIO        -8   /* a file could not be opened or mapped */
+
+/* Get the text of an error code, in the form passed to mexErrMsgTxt */
+const char *ANErrorMessage(int err);
+
+/* Random-number generator (splitmix64): the whole state is a single 64-bit word,
+   so it is cheap to keep one per fiber and to save it in a checkpoint */
+typedef struct __ANRAND { uint64_t s; int havespare; double spare; } ANRAND;
+
+void   ANRandSeed(ANRAND *rng, uint64_t seed);
+/* uniform deviate on the open interval (0,1) */
+double ANRandUniform(ANRAND *rng);
+/* standard normal deviate (Marsaglia polar method) */
+double ANRandNormal(ANRAND *rng);
+
+/* Growable binary blob used to serialise the model state */
+typedef struct __ANBLOB
+{
+    unsigned char *data;
+    size_t size, cap, pos;
+    int    err;             /* set when a read runs past the end or an allocation fails */
+} ANBLOB;
+
+void ANBlobInit(ANBLOB *blob);
+void ANBlobWrap(ANBLOB *blob, const void *data, size_t size); /* read-only view of existing data */
+void ANBlobFree(ANBLOB *blob);
+void ANBlobPut(ANBLOB *blob, const void *src, size_t n);
+void ANBlobGet(ANBLOB *blob, void *dst, size_t n);
+/* Write/check a section header: a tag identifying the section and the size of its fixed part */
+void ANBlobPutHeader(ANBLOB *blob, uint32_t tag, uint32_t size);
+int  ANBlobCheckHeader(ANBLOB *blob, uint32_t tag, uint32_t size);
+
+/* Workspace arena: the buffers of the model sections are carved out of one block that is
+   allocated once (per worker process, or per MEX session) and reused from one fiber to the
+   next, so that setting up a fiber does not touch the heap.  Each section has a WorkSize
+   function giving the bytes its Init takes from the workspace.  With a NULL workspace the
+   sections allocate from the heap, as before. */
+typedef struct __ANWORK
+{
+    unsigned char *base;
+    size_t size, used, peak;
+} ANWORK;
+
+#define AN_WORK_ALIGN 64
+#define ANWorkRound(n) (((size_t)(n)+AN_WORK_ALIGN-1) & ~(size_t)(AN_WORK_ALIGN-1))
+
+void   ANWorkInit(ANWORK *w);
+/* Grow the block to at least size bytes; only allowed while nothing is allocated from it */
+int    ANWorkReserve(ANWORK *w, size_t size);
+void   ANWorkFree(ANWORK *w);
+/* n bytes, uninitialised (ANWorkAlloc) or zero-filled (ANWorkCalloc); NULL if the workspace
+   is too small.  With w==NULL they fall back to malloc and calloc. */
+void  *ANWorkAlloc(ANWORK *w, size_t n);
+void  *ANWorkCalloc(ANWORK *w, size_t n);
+/* Release one buffer: freed if it came from the heap (w==NULL), kept in a workspace */
+void   ANWorkRelease(ANWORK *w, void *p);
+/* The workspace is released as a stack: ANWorkReset gives back everything allocated since
+   the ANWorkMark, so a fiber's buffers are released at once when it is done */
+size_t ANWorkMark(const ANWORK *w);
+void   ANWorkReset(ANWORK *w, size_t mark);
+
+#define AN_TAG_IHC   0x43484941u  /* "AIHC" */
+#define AN_TAG_SYN   0x4e595341u  /* "ASYN" */
+#define AN_TAG_SPK   0x4b505341u  /* "ASPK" */
+
+#endif
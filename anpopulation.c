@@ -0,0 +1,452 @@
+/*
+anpopulation.c is a stand-alone (MATLAB-free) program that runs a population of model fibers
+on one stimulus in several worker processes and writes the CF x time neurogram of mean rates.
+
+   anpopulation -i stim.bin -o rates.bin -r 100e3 -c 250,500,1000 [options]
+
+   -i file    stimulus in Pa, raw native-endian doubles (floats with -f)
+   -o file    output: one row of nsamp doubles (floats with -g) per item, or fewer with -B,
+              items ordered CF-major (item = icf*ntypes + itype)
+   -f, -g     single-precision input, output
+   -r fs      sampling rate in Hz (default 100e3)
+   -c list    comma-separated CFs in Hz, or
+   -n N -l lo -u hi   N CFs log-spaced between lo and hi
+   -t list    fiber types (1 low, 2 medium, 3 high spont; default 3)
+   -w N       number of worker processes (default: number of CPUs, a third of them with -L)
+   -L         run each fiber as a pipeline of three processes (control path, signal path and
+              IHC, synapse) joined by lock-free rings, for fewer fibers than CPUs
+   -p         pin worker w to CPU w
+   -m bytes   memory budget (with a k, M or G suffix): only as many workers run at a time as
+              fit in it, by the estimate of ANShardPeakBytes (not counting the stimulus and
+              output files, which are mapped); fails if not even one does (not with -F)
+   -s seed    base seed of the fGn (default 1)
+   -O cohc -I cihc -S species -N noiseType -M implnt   as for model_IHC/model_Synapse
+              (defaults 1, 1, 1, 1, 0)
+   -P prod    product written to the rows: ihc, synout, mean (default), var, psth or stats;
+              only the stages it needs are run (no synapse or fGn for ihc, no spike
+              generator unless psth or stats)
+   -T list    statistics of the spike train of each fiber written as its row with -P stats,
+              accumulated as the spikes occur (no spike times are stored): a comma-separated
+              list of isi:bin:n (ISI histogram of n bins of bin s), vs:f1:f2:... (vector
+              strength at f1, f2, ... Hz), fano:w1:w2:... (Fano factor of the counts in windows
+              of w1, w2, ... s) and psth:period:bin (PSTH over repetitions of period s, in bins
+              of bin s), e.g. -T isi:0.1e-3:200,vs:1000,fano:0.05:0.5.  A row holds the number
+              of spikes, the duration, the ISI counts, the vector strength and mean phase at each
+              frequency, the Fano factor and mean count of each window and the PSTH counts
+   -R rate    rate of the power-law section of the synapse in Hz (default 10e3), or "auto" to
+              lower it to 8 samples per period of the CF (at least 2 kHz) for CFs below 1250 Hz;
+              off 10 kHz the approximate implementation uses kernels fitted for the rate
+   -B list    reduce the rows on the fly, so that only the reduced neurogram is stored: a
+              comma-separated cascade of up to 4 stages type:seconds, where type is bin (mean
+              over bins), hamming (Hamming-weighted mean over windows overlapping by 50%) or
+              decimate (every n-th sample), e.g. -B bin:0.5e-3 for the PSTH of testANmodel.m
+              (as spike counts per sample: multiply by fs for spikes/s), or
+              -B bin:100e-6,hamming:12.8e-3 for an ENV neurogram (6.4 ms steps)
+   -F frame   real-time mode: run all the fibers in this process, frame by frame through the
+              frame API of realtime.c, and report the latency and the real-time factor (how
+              many fibers fit in real time on one core); the rows are the same as without -F
+              (cannot be combined with -B or -P stats; -w is ignored)
+   -Z level   stimulus samples within level (Pa) of zero count as silence, through which the
+              model is fast-forwarded once its filters have decayed (default 0: only exact
+              zeros, which is exact to within the decay tolerance of ihcan.h)
+   -K file    batch mode: the input is many stimuli back to back, whose lengths in samples
+              are listed in file (as text); the output is the rows of all the items for
+              each stimulus in turn, and every stimulus gets its own fGn and spikes.  The
+              fibers are set up once per worker and CF rather than per stimulus (see
+              batch.h; not with -F)
+   -v         report the stages that are skipped, the estimated peak memory, the fraction of
+              the samples fast-forwarded through silence (not counted with -L), and failed
+              workers and items
+
+Both files are memory-mapped: the workers read the stimulus from the page cache and write
+their rows straight into the output file.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "anmodel.h"
+#include "anfile.h"
+#include "population.h"
+#include "shard.h"
+#include "realtime.h"
+#include "batch.h"
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: anpopulation -i stim.bin -o rates.bin [-f] [-g] [-r fs] (-c cf,... | -n N -l lo -u hi)\n"
+                    "       [-t type,...] [-w workers] [-L] [-p] [-m bytes] [-s seed] [-O cohc] [-I cihc] [-S species]\n"
+                    "       [-N noiseType] [-M implnt] [-P ihc|synout|mean|var|psth|stats] [-R rate|auto]\n"
+                    "       [-B (bin|hamming|decimate):seconds,...] [-T isi:bin:n,vs:f:...,fano:w:...,psth:period:bin]\n"
+                    "       [-F frame] [-K lengths] [-Z level] [-v]\n");
+    exit(2);
+}
+
+static int ParseProduct(const char *s)
+{
+    if (!strcmp(s, "ihc"))    return(AN_PROD_IHC);
+    if (!strcmp(s, "synout")) return(AN_PROD_SYNOUT);
+    if (!strcmp(s, "mean"))   return(AN_PROD_MEANRATE);
+    if (!strcmp(s, "var"))    return(AN_PROD_VARRATE);
+    if (!strcmp(s, "psth"))   return(AN_PROD_PSTH);
+    if (!strcmp(s, "stats"))  return(AN_PROD_STATS);
+    return(0);
+}
+
+/* Reduction stages "type:seconds,..." with the lengths in samples at the input of each stage */
+static int ParseReduce(const char *s, double fs, ANREDSTAGE *red)
+{
+    int   n = 0;
+    char *end;
+    double t;
+
+    while (*s)
+    {
+        if (n==AN_RED_MAXSTAGE) return(-1);
+        if      (!strncmp(s, "bin:", 4))      { red[n].type = AN_RED_BIN;      s += 4; }
+        else if (!strncmp(s, "hamming:", 8))  { red[n].type = AN_RED_HAMMING;  s += 8; }
+        else if (!strncmp(s, "decimate:", 9)) { red[n].type = AN_RED_DECIMATE; s += 9; }
+        else return(-1);
+        t = strtod(s, &end);
+        if (end==s || t<=0) return(-1);
+        red[n].len = (long)floor(t*fs/ReducerFactor(red, n) + 0.5);
+        n++;
+        s = (*end==',') ? end+1 : end;
+    }
+    return(n);
+}
+
+/* Spike-train statistics "key:value:...,..." (see -T above) */
+static int ParseStats(const char *s, SPKSTATSPEC *st)
+{
+    double v[AN_STATS_MAXFREQ];
+    char  *end;
+    int    key, n, i;
+
+    while (*s)
+    {
+        if      (!strncmp(s, "isi:", 4))  { key = 0; s += 4; }
+        else if (!strncmp(s, "vs:", 3))   { key = 1; s += 3; }
+        else if (!strncmp(s, "fano:", 5)) { key = 2; s += 5; }
+        else if (!strncmp(s, "psth:", 5)) { key = 3; s += 5; }
+        else return(-1);
+        for (n=0; ; s++)
+        {
+            if (n==AN_STATS_MAXFREQ) return(-1);
+            v[n++] = strtod(s, &end);
+            if (end==s) return(-1);
+            s = end;
+            if (*s!=':') break;
+        }
+        switch (key)
+        {
+            case 0:
+                if (n!=2) return(-1);
+                st->isibin = v[0]; st->nisi = (int)v[1];
+                break;
+            case 1:
+                for (i=0; i<n; i++) st->freq[i] = v[i];
+                st->nfreq = n;
+                break;
+            case 2:
+                for (i=0; i<n; i++) st->win[i] = v[i];
+                st->nwin = n;
+                break;
+            case 3:
+                if (n!=2) return(-1);
+                st->period = v[0]; st->psthbin = v[1];
+                break;
+        }
+        if (*s==',') s++;
+        else if (*s) return(-1);
+    }
+    return(SpikeStatsCheck(st)==AN_OK ? 0 : -1);
+}
+
+/* Write n samples of each fiber's output frame y (fiber c at y[c*n]) to positions pos.. of the rows */
+static void PutFrames(ANSIGNAL *out, int nchan, long nsamp, long pos, const double *y, long n)
+{
+    long i;
+    int  c;
+
+    for (c=0; c<nchan; c++)
+        for (i=__max(0, -pos); i<n; i++)
+        {
+            if (out->fmt==AN_FLOAT32) ((float*)out->data)[(size_t)c*nsamp+pos+i] = (float)y[c*n+i];
+            else                      ((double*)out->data)[(size_t)c*nsamp+pos+i] = y[c*n+i];
+        }
+}
+
+/* Real-time mode: the stimulus is fed to the bank frame by frame, and the output frames,
+   which lag the model response by the latency, are written back into place in the rows */
+static int RunFrames(const ANPOPSPEC *spec, const ANSIGNAL *stim, long nsamp, ANSIGNAL *out, long frame, int verbose)
+{
+    ANRT    rt;
+    double *px, *y, skipped;
+    long    t, n, i;
+    int     err;
+
+    if ((err = ANRTInit(&rt, spec, frame, nsamp)) != AN_OK) return(err);
+    px = (double*)malloc(frame*sizeof(double));
+    y  = (double*)malloc(rt.nchan*__max(frame, rt.latency)*sizeof(double));
+    if (px==NULL || y==NULL) { free(px); free(y); ANRTFree(&rt); return(AN_ENOMEM); }
+
+    for (t=0; t<nsamp && err==AN_OK; t+=n)
+    {
+        n = __min(frame, nsamp-t);
+        for (i=0; i<n; i++)
+            px[i] = (stim->fmt==AN_FLOAT32) ? ((const float*)stim->data)[t+i] : ((const double*)stim->data)[t+i];
+        if ((err = ANRTProcess(&rt, px, n, y)) == AN_OK)
+            PutFrames(out, rt.nchan, nsamp, t-rt.latency, y, n);
+    }
+    if (err==AN_OK && (err = ANRTDrain(&rt, y)) == AN_OK)
+        PutFrames(out, rt.nchan, nsamp, nsamp-rt.latency, y, rt.latency);
+
+    if (err==AN_OK)
+        fprintf(stderr, "real time: %d fibers, frames of %ld samples (%.3g ms), latency %ld samples (%.3g ms);\n"
+                        "           real-time factor %.3g (%.3g per fiber), so about %.0f fibers per core\n",
+                rt.nchan, frame, frame*spec->tdres*1e3, rt.latency, rt.latency*spec->tdres*1e3,
+                ANRTFactor(&rt), ANRTFactor(&rt)/rt.nchan, (ANRTFactor(&rt)>0) ? rt.nchan/ANRTFactor(&rt) : 0.0);
+    if (verbose && err==AN_OK)
+    {
+        fprintf(stderr, "workspace of the bank: %.1f kB\n", rt.work.size/1024.0);
+        for (i=0, skipped=0; i<rt.nchan; i++) skipped += rt.chan[i].ihc.skipctl;
+        fprintf(stderr, "fast-forwarded through silence: %.1f%% of the samples\n", 100.0*skipped/((double)rt.nchan*nsamp));
+    }
+    free(px); free(y);
+    ANRTFree(&rt);
+    return(err);
+}
+
+/* The lengths of the stimuli of a batch, which must add up to nsamp; returns their number, or
+   -1 if the file cannot be read or does not list positive lengths that add up */
+static int ReadLengths(const char *file, long **len, long nsamp)
+{
+    FILE *fp = fopen(file, "r");
+    long  v, total = 0, *tmp;
+    int   n = 0, cap = 0;
+
+    if (fp==NULL) return(-1);
+    while (fscanf(fp, "%ld", &v)==1)
+    {
+        if (v<1) { fclose(fp); return(-1); }
+        if (n==cap)
+        {
+            cap = (cap>0) ? 2*cap : 256;
+            if ((tmp = (long*)realloc(*len, cap*sizeof(long))) == NULL) { fclose(fp); return(-1); }
+            *len = tmp;
+        }
+        (*len)[n++] = v;
+        total += v;
+    }
+    if (!feof(fp)) n = -1;   /* not a number */
+    fclose(fp);
+    return((n>0 && total==nsamp) ? n : -1);
+}
+
+static int ParseList(const char *s, double *v, int max)
+{
+    int   n = 0;
+    char *end;
+
+    while (*s && n<max)
+    {
+        v[n++] = strtod(s, &end);
+        if (end==s) return(-1);
+        s = (*end==',') ? end+1 : end;
+    }
+    return(*s ? -1 : n);
+}
+
+int main(int argc, char **argv)
+{
+    const char *infile = NULL, *outfile = NULL, *reduce = NULL, *stats = NULL, *lenfile = NULL;
+    double     fs = 100e3, lo = 0, hi = 0, types[3], *cf, skipped;
+    int        c, i, ncf = 0, err, stages, all, nw = 0, fit;
+    long       nsamp, rowlen, frame = 0, nitems, outlen, *len = NULL, maxlen;
+
+    ANPOPSPEC  spec;
+    ANSHARDOPT opt;
+    ANSHARDJOB job;
+    ANBATCH    batch;
+    ANSHARED   sh;
+    ANSIGNAL   stim, out;
+    ANMAP      in, map;
+
+    memset(&spec, 0, sizeof(spec));
+    stim.fmt = AN_FLOAT64; out.fmt = AN_FLOAT64;
+    spec.cohc = 1; spec.cihc = 1; spec.species = 1; spec.noiseType = 1; spec.implnt = 0; spec.seed = 1;
+    spec.ntypes = 1; spec.fibertype[0] = 3; spec.product = AN_PROD_MEANRATE;
+    opt.nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN); opt.pin = 0; opt.verbose = 0; opt.pipeline = 0;
+    opt.budget = 0;
+
+    cf = (double*)calloc(argc, sizeof(double));   /* -c lists are reallocated below */
+    while ((c = getopt(argc, argv, "i:o:fgr:c:n:l:u:t:w:Lpm:s:O:I:S:N:M:P:R:B:T:F:K:Z:v")) != -1)
+    {
+        switch (c)
+        {
+            case 'i': infile  = optarg; break;
+            case 'o': outfile = optarg; break;
+            case 'f': stim.fmt = AN_FLOAT32; break;
+            case 'g': out.fmt  = AN_FLOAT32; break;
+            case 'r': fs = atof(optarg); break;
+            case 'c':
+                free(cf);
+                cf  = (double*)calloc(strlen(optarg)/2+1, sizeof(double));
+                ncf = ParseList(optarg, cf, (int)strlen(optarg)/2+1);
+                if (ncf<1) Usage();
+                break;
+            case 'n': ncf = atoi(optarg); break;
+            case 'l': lo = atof(optarg); break;
+            case 'u': hi = atof(optarg); break;
+            case 't':
+                spec.ntypes = ParseList(optarg, types, 3);
+                if (spec.ntypes<1) Usage();
+                for (i=0; i<spec.ntypes; i++) spec.fibertype[i] = (int)types[i];
+                break;
+            case 'w': opt.nworkers = atoi(optarg); nw = 1; break;
+            case 'L': opt.pipeline = 1; break;
+            case 'p': opt.pin = 1; break;
+            case 'm': if ((opt.budget = ANParseBytes(optarg)) == 0) Usage(); break;
+            case 's': spec.seed = strtoull(optarg, NULL, 10); break;
+            case 'O': spec.cohc = atof(optarg); break;
+            case 'I': spec.cihc = atof(optarg); break;
+            case 'S': spec.species = atoi(optarg); break;
+            case 'N': spec.noiseType = atof(optarg); break;
+            case 'M': spec.implnt = atof(optarg); break;
+            case 'P':
+                spec.product = ParseProduct(optarg);
+                if (spec.product==0) Usage();
+                break;
+            case 'R': spec.synrate = strcmp(optarg, "auto") ? atof(optarg) : AN_SYNRATE_AUTO; break;
+            case 'B': reduce = optarg; break;
+            case 'T': stats  = optarg; break;
+            case 'F': frame = atol(optarg); if (frame<1) Usage(); break;
+            case 'K': lenfile = optarg; break;
+            case 'Z': spec.silence = atof(optarg); if (spec.silence<0) Usage(); break;
+            case 'v': opt.verbose = 1; break;
+            default:  Usage();
+        }
+    }
+    if (infile==NULL || outfile==NULL || ncf<1 || fs<=0) Usage();
+    if (opt.pipeline && !nw) opt.nworkers = __max(1, opt.nworkers/3);   /* three processes per worker */
+
+    if (lo>0 && hi>0)   /* log-spaced CFs */
+    {
+        free(cf);
+        cf = (double*)calloc(ncf, sizeof(double));
+        for (i=0; i<ncf; i++)
+            cf[i] = (ncf==1) ? lo : lo*pow(hi/lo, (double)i/(ncf-1));
+    }
+    spec.cf    = cf;
+    spec.ncf   = ncf;
+    spec.tdres = 1/fs;
+    if (reduce!=NULL && (spec.nred = ParseReduce(reduce, fs, spec.red))<1) Usage();   /* lengths depend on -r */
+    if (stats!=NULL && ParseStats(stats, &spec.stats)<0) Usage();
+    if (frame>0 && (spec.nred>0 || spec.product==AN_PROD_STATS || opt.budget>0 || lenfile!=NULL)) Usage();
+    if ((err = ANPopCheck(&spec)) != AN_OK)
+    {
+        fprintf(stderr, "anpopulation: %s", ANErrorMessage(err));
+        return(1);
+    }
+
+    if ((err = ANMapRead(&in, infile)) != AN_OK)
+    {
+        perror(infile);
+        return(1);
+    }
+    stim.data = in.data;
+    nsamp  = (long)(in.size/ANSignalSize(stim.fmt));
+    rowlen = ANPopOutLength(&spec, nsamp);
+    if (lenfile!=NULL)
+    {
+        if ((i = ReadLengths(lenfile, &len, nsamp)) < 1 || (err = ANBatchInit(&batch, &spec, i, len)) != AN_OK)
+        {
+            fprintf(stderr, "anpopulation: %s does not list the lengths of the stimuli in %s\n", lenfile, infile);
+            return(1);
+        }
+        ANBatchJob(&job, &batch, stim.fmt, opt.pipeline);
+        nitems = ANBatchNumItems(&batch);
+        outlen = batch.outoff[batch.nstim];
+        maxlen = batch.maxlen;
+    }
+    else
+    {
+        ANShardPopJob(&job, &spec, nsamp, stim.fmt, opt.pipeline);
+        nitems = ANPopNumItems(&spec);
+        outlen = nitems*rowlen;
+        maxlen = nsamp;
+    }
+    fit = ANShardFitWorkers(&job, nitems, &opt);
+    if (fit==0)
+    {
+        fprintf(stderr, "anpopulation: one worker needs %.1f MB, more than the memory budget\n",
+                ANShardPeakBytes(&job, nitems, 1)/1048576.0);
+        return(1);
+    }
+    if ((err = ANMapWrite(&map, outfile, (size_t)outlen*ANSignalSize(out.fmt))) != AN_OK)
+    {
+        perror(outfile);
+        return(1);
+    }
+    out.data = map.data;
+
+    if ((err = ANSharedCreate(&sh, nitems, nsamp, &stim, &out)) != AN_OK)
+    {
+        fprintf(stderr, "anpopulation: %s", ANErrorMessage(err));
+        return(1);
+    }
+
+    if (opt.verbose)
+    {
+        stages = ANPopStages(spec.product);
+        all    = AN_STAGE_IHC|AN_STAGE_SYNAPSE|AN_STAGE_SPIKES;
+        fprintf(stderr, "stages run: IHC%s%s; skipped:%s%s%s\n",
+                (stages & AN_STAGE_SYNAPSE) ? ", synapse (with fGn)" : "",
+                (stages & AN_STAGE_SPIKES)  ? ", spike generator" : "",
+                (stages & AN_STAGE_SYNAPSE) ? "" : " synapse (with fGn)",
+                (stages & AN_STAGE_SPIKES)  ? "" : " spike generator",
+                (stages==all) ? " none" : "");
+        fprintf(stderr, "memory per item: %.1f kB (%.1f kB for all the stages)\n",
+                ANPopItemBytes(&spec, maxlen, stages)/1024.0, ANPopItemBytes(&spec, maxlen, all)/1024.0);
+        if (lenfile!=NULL)
+            fprintf(stderr, "batch of %d stimuli of up to %ld samples, %ld output samples\n",
+                    batch.nstim, maxlen, outlen);
+        else if (spec.nred>0)
+            fprintf(stderr, "rows reduced from %ld to %ld samples (%g Hz)\n",
+                    nsamp, rowlen, fs/ReducerFactor(spec.red, spec.nred));
+        if (spec.product==AN_PROD_STATS)
+            fprintf(stderr, "rows of %ld statistics; no spike times are stored\n", rowlen);
+        if (frame==0)
+            fprintf(stderr, "peak memory: %.1f MB with %d worker(s) (%.1f MB each)\n",
+                    ANShardPeakBytes(&job, sh.nitems, fit)/1048576.0, fit, job.peak/1048576.0);
+    }
+
+    if (frame>0)
+        err = RunFrames(&spec, &stim, nsamp, &out, frame, opt.verbose);
+    else
+    {
+        err = (lenfile!=NULL) ? ANBatchRun(&batch, &sh, &opt) : ANShardRun(&spec, &sh, &opt);
+        if (opt.verbose && err==AN_OK && !opt.pipeline)
+        {
+            for (i=0, skipped=0; i<sh.nitems; i++) skipped += sh.items[i].skipped;
+            fprintf(stderr, "fast-forwarded through silence: %.1f%% of the samples\n",
+                    100.0*skipped/((double)ANPopNumItems(&spec)*nsamp));
+        }
+    }
+
+    ANSharedFree(&sh);
+    if (lenfile!=NULL) ANBatchFree(&batch);
+    free(len);
+    ANMapClose(&in);
+    ANMapClose(&map);
+    free(cf);
+    if (err!=AN_OK)
+    {
+        fprintf(stderr, "anpopulation: %s", ANErrorMessage(err));
+        return(1);
+    }
+    return(0);
+}
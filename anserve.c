@@ -0,0 +1,575 @@
+/*
+anserve.c is a stand-alone (MATLAB-free) daemon that serves the model to other local programs
+(experiment GUIs, notebooks, optimisation loops) over a Unix-domain socket, so that they pay
+neither the start-up of MATLAB nor the set-up of the fibers on every call.
+
+   anserve -u /tmp/anmodel.sock [-w workers] [-p] [-m bytes] [-W window] [-b max] [-v]
+
+   -u path    socket to listen on (an old socket at path is removed first)
+   -w N       number of worker processes of a batch (default: number of CPUs)
+   -p         pin worker w to CPU w
+   -m bytes   memory budget of a batch, as for anpopulation
+   -W window  seconds a request may wait for others of the same model to join its batch
+              (default 2e-3); a batch starts at once if every connected client is waiting
+   -b max     most requests in a batch (default 64)
+   -v         report every batch
+
+A client sends a request and waits for its reply; both are native-endian doubles.  A request
+is a header of SRV_NHDR values
+
+   fs, ncf, nsamp, product, ntypes, type1, type2, type3, cohc, cihc, species, noiseType,
+   implnt, synrate, seed, silence
+
+(product as AN_PROD_ in population.h, but not stats; synrate 0 for 10 kHz or -1 for auto;
+unused types ignored) followed by the ncf CFs in Hz and the nsamp samples of the stimulus in
+Pa.  The reply is a header of SRV_NREP values
+
+   status, rows, rowlen, batch, wait, run, latency, queue
+
+(status 0 or an AN_ error code of anmodel.h, the number of requests in the batch, the
+seconds the request waited in the queue and the batch ran, the seconds from the arrival of the
+request to its reply, and the requests queued when its batch started) followed by the rows
+of ANPopNumItems fibers of rowlen samples, CF-major as for anpopulation, which are those of
+anpopulation with the seed of the request.  A header with ncf 0 asks for the metrics instead:
+
+   0, requests served, batches, requests queued, mean wait, longest wait, mean latency,
+   longest latency
+
+Requests for the same model (all the fields but seed and nsamp, and the same CFs) that arrive
+within the window are run as one batch (batch.h) in the worker processes.  The replies are
+written by the daemon itself, so a client that does not take its whole reply within
+SRV_SENDTIME seconds is dropped rather than let stall the others.  After each batch
+the daemon sets the fibers of the batch up once itself, so that the tables of C1, the filters
+of the resamplers and the power-law fits of the last few CFs (ihcan.c, resample.c,
+powerlaw.c) are in the caches of the workers it forks for the next batch.  SIGINT or SIGTERM
+stops it with a summary of the metrics.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "anmodel.h"
+#include "anfile.h"
+#include "ihcan.h"
+#include "population.h"
+#include "shard.h"
+#include "batch.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define SRV_NHDR      16        /* doubles in the header of a request */
+#define SRV_NREP      8         /* and of a reply */
+#define SRV_MAXCLIENT 256
+#define SRV_MAXCF     4096
+#define SRV_MAXBYTES  (1<<30)   /* largest request */
+#define SRV_WARMLEN   64        /* samples of silence run by each fiber of a batch to warm the caches */
+#define SRV_SENDTIME  1.0       /* seconds a client has to take its reply */
+
+/* Fields of the request header */
+#define RQ_FS       0
+#define RQ_NCF      1
+#define RQ_NSAMP    2
+#define RQ_PRODUCT  3
+#define RQ_NTYPES   4
+#define RQ_TYPE     5           /* to 7 */
+#define RQ_COHC     8
+#define RQ_CIHC     9
+#define RQ_SPECIES  10
+#define RQ_NOISE    11
+#define RQ_IMPLNT   12
+#define RQ_SYNRATE  13
+#define RQ_SEED     14
+#define RQ_SILENCE  15
+
+typedef struct __SRVCLIENT
+{
+    int     fd;                 /* -1 for a free slot */
+    double  hdr[SRV_NHDR];
+    double *body;               /* the CFs and then the stimulus */
+    size_t  have, need;         /* bytes of the request received and expected (header included) */
+    int     queued;             /* the request is complete and waits for its batch */
+    double  arrival;            /* time it was complete */
+    long    nsamp;
+    ANPOPSPEC spec;             /* its model, with the CFs in body */
+} SRVCLIENT;
+
+typedef struct __SRVSTATS
+{
+    long   served, batches;
+    double waitsum, waitmax, latsum, latmax;
+    int    maxqueue;
+} SRVSTATS;
+
+static volatile sig_atomic_t stop = 0;
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: anserve -u socket [-w workers] [-p] [-m bytes] [-W window] [-b max] [-v]\n");
+    exit(2);
+}
+
+static void Stop(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec + 1e-9*ts.tv_nsec);
+}
+
+/* Write n bytes by the deadline; a write that blocks longer than the SO_SNDTIMEO of the
+   socket fails with EAGAIN, so a client that stopped reading is given up in time */
+static int WriteAll(int fd, const void *buf, size_t n, double deadline)
+{
+    const char *p = (const char*)buf;
+    ssize_t     r;
+
+    while (n>0)
+    {
+        if (Now()>deadline) return(-1);
+        r = write(fd, p, n);
+        if (r<0 && errno==EINTR) continue;
+        if (r<=0) return(-1);
+        p += r; n -= r;
+    }
+    return(0);
+}
+
+static int Reply(SRVCLIENT *c, const double *rep, const double *rows, long n)
+{
+    double deadline = Now()+SRV_SENDTIME;
+
+    if (WriteAll(c->fd, rep, SRV_NREP*sizeof(double), deadline)<0) return(-1);
+    return((n>0) ? WriteAll(c->fd, rows, n*sizeof(double), deadline) : 0);
+}
+
+static int ReplyError(SRVCLIENT *c, int err)
+{
+    double rep[SRV_NREP];
+
+    memset(rep, 0, sizeof(rep));
+    rep[0] = err;
+    return(Reply(c, rep, NULL, 0));
+}
+
+static void CloseClient(SRVCLIENT *c)
+{
+    close(c->fd);
+    free(c->body);
+    memset(c, 0, sizeof(SRVCLIENT));
+    c->fd = -1;
+}
+
+/* Ready for the next request */
+static void ResetClient(SRVCLIENT *c)
+{
+    free(c->body);
+    c->body = NULL;
+    c->have = 0; c->need = 0; c->queued = 0;
+}
+
+static int IsInt(double x, double lo, double hi)
+{
+    return(x>=lo && x<=hi && x==floor(x));
+}
+
+/* One of the products served (all but AN_PROD_STATS) */
+static int IsProduct(double p)
+{
+    return(p==AN_PROD_IHC || p==AN_PROD_SYNOUT || p==AN_PROD_MEANRATE || p==AN_PROD_VARRATE || p==AN_PROD_PSTH);
+}
+
+/* Check the header of a request and take its model; returns the number of bytes of the request
+   (the header alone for a metrics request), or 0 if the header is not valid */
+static size_t ParseHeader(SRVCLIENT *c)
+{
+    const double *h = c->hdr;
+    ANPOPSPEC    *s = &c->spec;
+    double        bytes;
+    int           i;
+
+    /* a NaN would pass the range tests of ANPopCheck and match no model in SameModel */
+    for (i=0; i<SRV_NHDR; i++)
+        if (!(fabs(h[i])<HUGE_VAL)) return(0);
+    if (!IsInt(h[RQ_NCF], 0, SRV_MAXCF)) return(0);
+    if (h[RQ_NCF]==0) return(SRV_NHDR*sizeof(double));
+    bytes = (SRV_NHDR + h[RQ_NCF] + h[RQ_NSAMP])*sizeof(double);
+    if (!(h[RQ_FS]>0) || !IsInt(h[RQ_NSAMP], 1, SRV_MAXBYTES) || bytes>SRV_MAXBYTES
+        || !IsInt(h[RQ_NTYPES], 1, 3) || !IsProduct(h[RQ_PRODUCT]) || !IsInt(h[RQ_SPECIES], 1, 3)
+        || !IsInt(h[RQ_SEED], 0, 9007199254740992.0)) return(0);
+    for (i=0; i<h[RQ_NTYPES]; i++)
+        if (!IsInt(h[RQ_TYPE+i], 1, 3)) return(0);
+
+    memset(s, 0, sizeof(ANPOPSPEC));
+    s->tdres     = 1/h[RQ_FS];
+    s->ncf       = (int)h[RQ_NCF];
+    s->ntypes    = (int)h[RQ_NTYPES];
+    for (i=0; i<s->ntypes; i++) s->fibertype[i] = (int)h[RQ_TYPE+i];
+    s->product   = (int)h[RQ_PRODUCT];
+    s->cohc      = h[RQ_COHC];
+    s->cihc      = h[RQ_CIHC];
+    s->species   = (int)h[RQ_SPECIES];
+    s->noiseType = h[RQ_NOISE];
+    s->implnt    = h[RQ_IMPLNT];
+    s->synrate   = h[RQ_SYNRATE];
+    s->seed      = (uint64_t)h[RQ_SEED];
+    s->silence   = h[RQ_SILENCE];
+    c->nsamp     = (long)h[RQ_NSAMP];
+    return((size_t)bytes);
+}
+
+static int SameModel(const ANPOPSPEC *a, const ANPOPSPEC *b)
+{
+    return(a->tdres==b->tdres && a->cohc==b->cohc && a->cihc==b->cihc && a->noiseType==b->noiseType
+           && a->implnt==b->implnt && a->species==b->species && a->product==b->product
+           && a->synrate==b->synrate && a->silence==b->silence && a->ncf==b->ncf && a->ntypes==b->ntypes
+           && !memcmp(a->fibertype, b->fibertype, a->ntypes*sizeof(int))
+           && !memcmp(a->cf, b->cf, a->ncf*sizeof(double)));
+}
+
+static void Metrics(SRVCLIENT *cl, const SRVSTATS *st, double *rep)
+{
+    int i;
+
+    memset(rep, 0, SRV_NREP*sizeof(double));
+    rep[1] = st->served;
+    rep[2] = st->batches;
+    for (i=0; i<SRV_MAXCLIENT; i++) rep[3] += cl[i].queued;
+    rep[4] = (st->served>0) ? st->waitsum/st->served : 0;
+    rep[5] = st->waitmax;
+    rep[6] = (st->served>0) ? st->latsum/st->served : 0;
+    rep[7] = st->latmax;
+}
+
+/* Read what client c has sent; returns -1 if it is to be closed */
+static int ReadClient(SRVCLIENT *cl, SRVCLIENT *c, const SRVSTATS *st)
+{
+    size_t  hb = SRV_NHDR*sizeof(double);
+    double  rep[SRV_NREP];
+    ssize_t r;
+    int     err;
+
+    if (c->have<hb)
+    {
+        r = read(c->fd, (char*)c->hdr+c->have, hb-c->have);
+        if (r<=0) return(-1);
+        c->have += r;
+        if (c->have<hb) return(0);
+        if ((c->need = ParseHeader(c)) == 0)
+        {
+            ReplyError(c, AN_EPARAM);   /* the rest of the stream cannot be followed */
+            return(-1);
+        }
+        if (c->need==hb)
+        {
+            Metrics(cl, st, rep);
+            ResetClient(c);
+            return(Reply(c, rep, NULL, 0));
+        }
+        c->body = (double*)malloc(c->need-hb);
+        if (c->body==NULL) { ReplyError(c, AN_ENOMEM); return(-1); }
+        return(0);
+    }
+
+    r = read(c->fd, (char*)c->body+(c->have-hb), c->need-c->have);
+    if (r<=0) return(-1);
+    c->have += r;
+    if (c->have<c->need) return(0);
+
+    c->spec.cf = c->body;
+    err = ANPopCheck(&c->spec);
+    if (err!=AN_OK)
+    {
+        ResetClient(c);
+        return(ReplyError(c, err));
+    }
+    c->queued  = 1;
+    c->arrival = Now();
+    return(0);
+}
+
+/* Set every fiber of spec up once in this process, on a few samples of silence, so that the
+   workers forked later find their tables in the caches; more CFs than the caches hold would
+   only push one another out */
+static void Warm(const ANPOPSPEC *spec)
+{
+    double   x[SRV_WARMLEN], *rows;
+    ANSIGNAL in, out;
+    int      i, nfib = ANPopNumItems(spec);
+
+    if (spec->ncf>AN_C1_NCACHE) return;
+    rows = (double*)malloc((size_t)nfib*ANPopOutLength(spec, SRV_WARMLEN)*sizeof(double));
+    if (rows==NULL) return;
+    memset(x, 0, sizeof(x));
+    in.fmt  = AN_FLOAT64; in.data  = x;
+    out.fmt = AN_FLOAT64; out.data = rows;
+    for (i=0; i<nfib; i++) ANPopRunItem(spec, i, &in, SRV_WARMLEN, &out, NULL, NULL, NULL);
+    free(rows);
+}
+
+/* Run the oldest request together with the others of the same model in the queue (up to max),
+   reply to each and warm the caches for the next batch of that model; every request of the
+   batch leaves the queue, with an error reply if the batch failed */
+static void RunBatch(SRVCLIENT *cl, int first, int max, const ANSHARDOPT *opt, SRVSTATS *st, int verbose)
+{
+    ANPOPSPEC  spec = cl[first].spec;
+    ANSHARDOPT bopt = *opt;
+    ANBATCH    b;
+    ANSHARED   sh;
+    ANSIGNAL   stim, out;
+    sigset_t   mask, old;
+    double     rep[SRV_NREP], t0, t1, wait;
+    long       len[SRV_MAXCLIENT], outlen = 0;
+    uint64_t   seed[SRV_MAXCLIENT];
+    int        idx[SRV_MAXCLIENT], dead[SRV_MAXCLIENT], n = 1, nq = 0, i, s, t, err;
+
+    /* the oldest is in the batch whatever SameModel says, so the queue always moves */
+    idx[0] = first;
+    for (i=0; i<SRV_MAXCLIENT; i++)
+        if (cl[i].queued)
+        {
+            nq++;
+            if (i!=first && n<max && SameModel(&cl[i].spec, &spec)) idx[n++] = i;
+        }
+    /* in order of arrival, so that the oldest are served first when there are more than max */
+    for (s=1; s<n; s++)
+        for (i=s; i>0 && cl[idx[i]].arrival<cl[idx[i-1]].arrival; i--)
+        {
+            t = idx[i]; idx[i] = idx[i-1]; idx[i-1] = t;
+        }
+    for (s=0; s<n; s++)
+    {
+        len[s]  = cl[idx[s]].nsamp;
+        seed[s] = cl[idx[s]].spec.seed;
+    }
+    if (nq>st->maxqueue) st->maxqueue = nq;
+
+    stim.fmt = AN_FLOAT64; stim.data = NULL;
+    out.fmt  = AN_FLOAT64; out.data  = MAP_FAILED;
+    memset(&sh, 0, sizeof(sh));
+    t0 = Now();
+    if ((err = ANBatchInit(&b, &spec, n, len)) == AN_OK)
+    {
+        b.seed = seed;
+        outlen = b.outoff[n];
+        stim.data = malloc(b.inoff[n]*sizeof(double));
+        out.data  = mmap(NULL, outlen*sizeof(double), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+        if (stim.data==NULL || out.data==MAP_FAILED) err = AN_ENOMEM;
+    }
+    if (err==AN_OK)
+    {
+        for (s=0; s<n; s++)
+            memcpy((double*)stim.data+b.inoff[s], cl[idx[s]].body+spec.ncf, len[s]*sizeof(double));
+        err = ANSharedCreate(&sh, ANBatchNumItems(&b), b.inoff[n], &stim, &out);
+    }
+    if (err==AN_OK)
+    {
+        /* a stop signal must not break the wait for the workers */
+        bopt.nworkers = (int)__min(opt->nworkers, ANBatchNumItems(&b));
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        sigprocmask(SIG_BLOCK, &mask, &old);
+        err = ANBatchRun(&b, &sh, &bopt);
+        sigprocmask(SIG_SETMASK, &old, NULL);
+    }
+    t1 = Now();
+
+    for (s=0; s<n; s++)
+    {
+        SRVCLIENT *c = &cl[idx[s]];
+
+        wait   = t0-c->arrival;
+        rep[0] = err;
+        rep[1] = (err==AN_OK) ? b.nfib : 0;
+        rep[2] = (err==AN_OK) ? ANPopOutLength(&spec, len[s]) : 0;
+        rep[3] = n;
+        rep[4] = wait;
+        rep[5] = t1-t0;
+        rep[6] = Now()-c->arrival;
+        rep[7] = nq;
+        dead[s] = Reply(c, rep, (err==AN_OK) ? (double*)out.data+b.outoff[s] : NULL,
+                        (err==AN_OK) ? b.outoff[s+1]-b.outoff[s] : 0) < 0;
+        if (dead[s]) continue;
+        st->served++;
+        st->waitsum += wait;
+        st->latsum  += rep[6];
+        if (wait>st->waitmax)  st->waitmax = wait;
+        if (rep[6]>st->latmax) st->latmax  = rep[6];
+    }
+    st->batches++;
+    if (verbose)
+    {
+        fprintf(stderr, "batch of %d request(s) of %d fibers (%d queued): waited %.3g to %.3g ms, ran %.3g ms\n",
+                n, (err==AN_OK) ? b.nfib : 0, nq, 1e3*(t0-cl[idx[n-1]].arrival), 1e3*(t0-cl[idx[0]].arrival), 1e3*(t1-t0));
+        if (err!=AN_OK) fprintf(stderr, "batch failed: %s", ANErrorMessage(err));
+    }
+
+    if (sh.base!=NULL) ANSharedFree(&sh);
+    if (out.data!=MAP_FAILED) munmap(out.data, outlen*sizeof(double));
+    free(stim.data);
+    ANBatchFree(&b);
+
+    /* the CFs are still in the body of the first request */
+    if (err==AN_OK) Warm(&spec);
+    for (s=0; s<n; s++)
+    {
+        if (dead[s]) CloseClient(&cl[idx[s]]);
+        else         ResetClient(&cl[idx[s]]);
+    }
+}
+
+static int Listen(const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat        sb;
+    int                fd;
+
+    if (strlen(path)>=sizeof(addr.sun_path)) { errno = ENAMETOOLONG; return(-1); }
+    if (stat(path, &sb)==0 && S_ISSOCK(sb.st_mode)) unlink(path);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) return(-1);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr))<0 || listen(fd, SOMAXCONN)<0)
+    {
+        close(fd);
+        return(-1);
+    }
+    return(fd);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    double     window = 2e-3, oldest, timeout;
+    int        c, i, n, lfd, fd, nclient, nq, first, max = 64, verbose = 0;
+
+    static SRVCLIENT cl[SRV_MAXCLIENT];
+    struct pollfd    pfd[SRV_MAXCLIENT+1];
+    int        slot[SRV_MAXCLIENT+1];
+    struct sigaction sa;
+    struct timeval   sndtime;
+    ANSHARDOPT opt;
+    SRVSTATS   st;
+
+    opt.nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN); opt.pin = 0; opt.verbose = 0; opt.pipeline = 0;
+    opt.budget = 0;
+    memset(&st, 0, sizeof(st));
+    sndtime.tv_sec  = (time_t)SRV_SENDTIME;
+    sndtime.tv_usec = (long)(1e6*(SRV_SENDTIME-floor(SRV_SENDTIME)));
+
+    while ((c = getopt(argc, argv, "u:w:pm:W:b:v")) != -1)
+    {
+        switch (c)
+        {
+            case 'u': path = optarg; break;
+            case 'w': opt.nworkers = atoi(optarg); if (opt.nworkers<1) Usage(); break;
+            case 'p': opt.pin = 1; break;
+            case 'm': if ((opt.budget = ANParseBytes(optarg)) == 0) Usage(); break;
+            case 'W': window = atof(optarg); if (window<0) Usage(); break;
+            case 'b': max = atoi(optarg); if (max<1 || max>SRV_MAXCLIENT) Usage(); break;
+            case 'v': verbose = 1; break;
+            default:  Usage();
+        }
+    }
+    if (path==NULL) Usage();
+
+    if ((lfd = Listen(path)) < 0)
+    {
+        perror(path);
+        return(1);
+    }
+    for (i=0; i<SRV_MAXCLIENT; i++) cl[i].fd = -1;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = Stop;        /* no SA_RESTART: poll returns */
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);    /* a client that went away fails its write instead */
+    if (verbose) fprintf(stderr, "anserve: listening on %s with %d worker(s)\n", path, opt.nworkers);
+
+    while (!stop)
+    {
+        /* the queued clients are not read until their reply is sent */
+        pfd[0].fd = lfd; pfd[0].events = POLLIN;
+        oldest = -1; nclient = 0; nq = 0;
+        for (i=0, n=1; i<SRV_MAXCLIENT; i++)
+        {
+            if (cl[i].fd<0) continue;
+            nclient++;
+            if (cl[i].queued)
+            {
+                nq++;
+                if (oldest<0 || cl[i].arrival<oldest) oldest = cl[i].arrival;
+                continue;
+            }
+            pfd[n].fd = cl[i].fd; pfd[n].events = POLLIN; slot[n++] = i;
+        }
+        timeout = (nq>0) ? __max(0, ceil(1e3*(oldest+window-Now()))) : -1;
+        if (poll(pfd, n, (nq>0 && nq==nclient) ? 0 : (int)timeout) < 0)
+        {
+            if (errno==EINTR) continue;
+            perror("anserve: poll");
+            break;
+        }
+
+        if (pfd[0].revents & POLLIN)
+        {
+            if ((fd = accept(lfd, NULL, NULL)) >= 0)
+            {
+                for (i=0; i<SRV_MAXCLIENT && cl[i].fd>=0; i++);
+                if (i<SRV_MAXCLIENT && setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sndtime, sizeof(sndtime))==0)
+                    cl[i].fd = fd;
+                else close(fd);
+            }
+        }
+        for (i=1; i<n; i++)
+            if ((pfd[i].revents & (POLLIN|POLLHUP|POLLERR)) && ReadClient(cl, &cl[slot[i]], &st)<0)
+                CloseClient(&cl[slot[i]]);
+
+        /* batches start once the oldest request has waited the window, the queue is full or
+           no client is left that could join them */
+        for (;;)
+        {
+            first = -1; nq = 0; nclient = 0;
+            for (i=0; i<SRV_MAXCLIENT; i++)
+            {
+                if (cl[i].fd<0) continue;
+                nclient++;
+                if (!cl[i].queued) continue;
+                nq++;
+                if (first<0 || cl[i].arrival<cl[first].arrival) first = i;
+            }
+            if (first<0 || (nq<max && nq<nclient && Now()-cl[first].arrival<window)) break;
+            RunBatch(cl, first, max, &opt, &st, verbose);
+        }
+    }
+
+    fprintf(stderr, "anserve: %ld request(s) in %ld batch(es), up to %d queued; wait %.3g ms on average (longest %.3g ms), "
+                    "latency %.3g ms on average (longest %.3g ms)\n",
+            st.served, st.batches, st.maxqueue, (st.served>0) ? 1e3*st.waitsum/st.served : 0.0, 1e3*st.waitmax,
+            (st.served>0) ? 1e3*st.latsum/st.served : 0.0, 1e3*st.latmax);
+    for (i=0; i<SRV_MAXCLIENT; i++)
+        if (cl[i].fd>=0) CloseClient(&cl[i]);
+    close(lfd);
+    unlink(path);
+    return(0);
+}
@@ -0,0 +1,161 @@
+/*
+anthreshold.c is a stand-alone (MATLAB-free) program that finds the thresholds of model fibers
+to tones by adaptive (bisection) searches on the level, for many points in several worker
+processes, e.g. for iso-rate tuning curves or tables like THRESHOLD_ALL_*.mat.
+
+   anthreshold -r 100e3 -n 30 -l 125 -u 20e3 [-C 1,0.5,0] [-H 1,0.5] [options]
+
+   -r fs      sampling rate in Hz (default 100e3)
+   -c list    comma-separated CFs in Hz, or
+   -n N -l lo -u hi   N CFs log-spaced between lo and hi
+   -q list    tone frequencies in Hz (default: the CF of each point); with several, each CF
+              gets a tuning curve
+   -C list    cohc values (default 1)
+   -H list    cihc values (default 1)
+   -S species -t fibertype -N noiseType -M implnt   as for model_IHC/model_Synapse and
+              anpopulation (defaults 1, 3, 1, 0)
+   -R rate    rate of the power-law section of the synapse in Hz, or "auto" (see anpopulation)
+   -s seed    base seed of the fGn (default 1; point i uses seed+i)
+   -d dur     tone duration in s (default 50e-3)
+   -m ramp    linear rise/fall time in s (default 2.5e-3)
+   -k rate    criterion: rate above spont in spikes/s (default 10)
+   -a lo -b hi   search range in dB SPL (default -10 to 120)
+   -e tol     resolution of the threshold in dB (default 0.5)
+   -w N       number of worker processes (default: number of CPUs)
+   -v         report failed workers and points
+
+The points are ordered cf, freq, cihc, cohc (cohc fastest), and one line per point
+"cf freq cohc cihc thr spont nsim" is written to stdout: the threshold in dB SPL (NaN if the
+criterion is not reached at hi), the spontaneous rate and the number of simulations run.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "anmodel.h"
+#include "population.h"
+#include "shard.h"
+#include "threshold.h"
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: anthreshold [-r fs] (-c cf,... | -n N -l lo -u hi) [-q freq,...] [-C cohc,...]\n"
+                    "       [-H cihc,...] [-S species] [-t fibertype] [-N noiseType] [-M implnt] [-R rate|auto]\n"
+                    "       [-s seed] [-d dur] [-m ramp] [-k rate] [-a lo] [-b hi] [-e tol] [-w workers] [-v]\n");
+    exit(2);
+}
+
+/* A comma-separated list, allocated to fit */
+static int ParseList(const char *s, double **v)
+{
+    int   n = 0;
+    char *end;
+
+    free(*v);
+    *v = (double*)calloc(strlen(s)/2+1, sizeof(double));
+    while (*s)
+    {
+        (*v)[n++] = strtod(s, &end);
+        if (end==s) return(-1);
+        s = (*end==',') ? end+1 : end;
+    }
+    return(n);
+}
+
+int main(int argc, char **argv)
+{
+    double      fs = 100e3, lo = 0, hi = 0, one = 1;
+    double      *cf = NULL, *freq = NULL, *cohc = NULL, *cihc = NULL;
+    int         c, ncf = 0, nfreq = 0, nohc = 0, nihc = 0, err;
+    long        i, j, k, m, n;
+
+    ANTHRSPEC   spec;
+    ANTHRPOINT  *pts;
+    ANTHRRESULT *res;
+    ANSHARDOPT  opt;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.species = 1; spec.fibertype = 3; spec.noiseType = 1; spec.implnt = 0; spec.seed = 1;
+    spec.dur = 50e-3; spec.ramp = 2.5e-3; spec.criterion = 10; spec.lo = -10; spec.hi = 120; spec.tol = 0.5;
+    opt.nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN); opt.pin = 0; opt.verbose = 0; opt.pipeline = 0; opt.budget = 0;
+
+    while ((c = getopt(argc, argv, "r:c:n:l:u:q:C:H:S:t:N:M:R:s:d:m:k:a:b:e:w:v")) != -1)
+    {
+        switch (c)
+        {
+            case 'r': fs = atof(optarg); break;
+            case 'c': if ((ncf = ParseList(optarg, &cf)) < 1) Usage(); break;
+            case 'n': ncf = atoi(optarg); break;
+            case 'l': lo = atof(optarg); break;
+            case 'u': hi = atof(optarg); break;
+            case 'q': if ((nfreq = ParseList(optarg, &freq)) < 1) Usage(); break;
+            case 'C': if ((nohc = ParseList(optarg, &cohc)) < 1) Usage(); break;
+            case 'H': if ((nihc = ParseList(optarg, &cihc)) < 1) Usage(); break;
+            case 'S': spec.species = atoi(optarg); break;
+            case 't': spec.fibertype = atoi(optarg); break;
+            case 'N': spec.noiseType = atof(optarg); break;
+            case 'M': spec.implnt = atof(optarg); break;
+            case 'R': spec.synrate = strcmp(optarg, "auto") ? atof(optarg) : AN_SYNRATE_AUTO; break;
+            case 's': spec.seed = strtoull(optarg, NULL, 10); break;
+            case 'd': spec.dur = atof(optarg); break;
+            case 'm': spec.ramp = atof(optarg); break;
+            case 'k': spec.criterion = atof(optarg); break;
+            case 'a': spec.lo = atof(optarg); break;
+            case 'b': spec.hi = atof(optarg); break;
+            case 'e': spec.tol = atof(optarg); break;
+            case 'w': opt.nworkers = atoi(optarg); break;
+            case 'v': opt.verbose = 1; break;
+            default:  Usage();
+        }
+    }
+    if (ncf<1 || fs<=0) Usage();
+    if (lo>0 && hi>0)   /* log-spaced CFs */
+    {
+        free(cf);
+        cf = (double*)calloc(ncf, sizeof(double));
+        for (i=0; i<ncf; i++)
+            cf[i] = (ncf==1) ? lo : lo*pow(hi/lo, (double)i/(ncf-1));
+    }
+    if (cf==NULL) Usage();
+    if (nohc==0) { cohc = &one; nohc = 1; }
+    if (nihc==0) { cihc = &one; nihc = 1; }
+
+    n   = (long)ncf*__max(nfreq, 1)*nihc*nohc;
+    pts = (ANTHRPOINT*)calloc(n, sizeof(ANTHRPOINT));
+    res = (ANTHRRESULT*)calloc(n, sizeof(ANTHRRESULT));
+    if (pts==NULL || res==NULL)
+    {
+        fprintf(stderr, "anthreshold: %s", ANErrorMessage(AN_ENOMEM));
+        return(1);
+    }
+    for (m=0, i=0; i<ncf; i++)
+        for (j=0; j<__max(nfreq, 1); j++)
+            for (k=0; k<nihc*nohc; k++, m++)
+            {
+                pts[m].cf   = cf[i];
+                pts[m].freq = (nfreq>0) ? freq[j] : cf[i];
+                pts[m].cihc = cihc[k/nohc];
+                pts[m].cohc = cohc[k%nohc];
+            }
+    spec.tdres = 1/fs;
+    spec.npts  = n;
+    spec.pts   = pts;
+
+    err = ANThrRun(&spec, &opt, res);
+    if (err==AN_OK || err==AN_EWORKER || opt.verbose)
+        for (m=0; m<n; m++)
+            printf("%g %g %g %g %.2f %.2f %.0f\n", pts[m].cf, pts[m].freq, pts[m].cohc, pts[m].cihc,
+                   res[m].thr, res[m].spont, res[m].nsim);
+
+    free(pts); free(res); free(cf); free(freq);
+    if (cohc!=&one) free(cohc);
+    if (cihc!=&one) free(cihc);
+    if (err!=AN_OK)
+    {
+        fprintf(stderr, "anthreshold: %s", ANErrorMessage(err));
+        return(1);
+    }
+    return(0);
+}
@@ -0,0 +1,92 @@
+/*
+batch.c runs many stimuli through a population, packed back to back: each item is one fiber
+on one stimulus, run by ANPopRunItem on views of the packed arrays
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "anmodel.h"
+#include "population.h"
+#include "shard.h"
+#include "batch.h"
+
+int ANBatchInit(ANBATCH *b, const ANPOPSPEC *spec, int nstim, const long *len)
+{
+    int s;
+
+    memset(b, 0, sizeof(ANBATCH));
+    if (nstim<1) return(AN_EPARAM);
+    for (s=0; s<nstim; s++)
+        if (len[s]<1) return(AN_EPARAM);
+
+    b->spec   = spec;
+    b->nstim  = nstim;
+    b->nfib   = ANPopNumItems(spec);
+    b->inoff  = (long*)malloc((nstim+1)*sizeof(long));
+    b->outoff = (long*)malloc((nstim+1)*sizeof(long));
+    if (b->inoff==NULL || b->outoff==NULL) { ANBatchFree(b); return(AN_ENOMEM); }
+
+    b->inoff[0] = 0; b->outoff[0] = 0;
+    for (s=0; s<nstim; s++)
+    {
+        b->inoff[s+1]  = b->inoff[s] + len[s];
+        b->outoff[s+1] = b->outoff[s] + b->nfib*ANPopOutLength(spec, len[s]);
+        if (len[s]>b->maxlen) b->maxlen = len[s];
+    }
+    return(AN_OK);
+}
+
+void ANBatchFree(ANBATCH *b)
+{
+    free(b->inoff);  b->inoff = NULL;
+    free(b->outoff); b->outoff = NULL;
+}
+
+long ANBatchNumItems(const ANBATCH *b)
+{
+    return((long)b->nfib*b->nstim);
+}
+
+int ANBatchRunItem(const ANBATCH *b, long item, const ANSIGNAL *px, ANSIGNAL *out, ANWORK *work,
+                   struct __ANPIPE *pipe, long *skipped)
+{
+    ANPOPSPEC spec = *b->spec;
+    ANSIGNAL  in, rows;
+    int       s = (int)(item % b->nstim), fib = (int)(item / b->nstim);
+
+    /* the stimulus and the rows of stimulus s, as a population of its own */
+    spec.seed  = (b->seed!=NULL) ? b->seed[s] : spec.seed + 2*(uint64_t)s*b->nfib;
+    in.fmt     = px->fmt;
+    in.data    = (char*)px->data + (size_t)b->inoff[s]*ANSignalSize(px->fmt);
+    rows.fmt   = out->fmt;
+    rows.data  = (char*)out->data + (size_t)b->outoff[s]*ANSignalSize(out->fmt);
+    return(ANPopRunItem(&spec, fib, &in, b->inoff[s+1]-b->inoff[s], &rows, work, pipe, skipped));
+}
+
+/* The items of a batch, as those of a population (shard.c) */
+static int BatchItem(const void *ctx, ANSHARED *sh, long item, ANWORK *work, struct __ANPIPE *pipe)
+{
+    long skipped;
+    int  err;
+
+    err = ANBatchRunItem((const ANBATCH*)ctx, item, &sh->stim, &sh->out, work, pipe, &skipped);
+    sh->items[item].skipped = skipped;
+    return(err);
+}
+
+void ANBatchJob(ANSHARDJOB *job, const ANBATCH *b, int fmt, int pipeline)
+{
+    /* the workspace and the memory of an item grow with the length of the stimulus */
+    job->run      = BatchItem;
+    job->ctx      = b;
+    job->worksize = ANPopMaxWorkSize(b->spec, b->maxlen, fmt);
+    job->peak     = ANPopPeakBytes(b->spec, b->maxlen, fmt, pipeline);
+}
+
+int ANBatchRun(const ANBATCH *b, ANSHARED *sh, const ANSHARDOPT *opt)
+{
+    ANSHARDJOB job;
+
+    ANBatchJob(&job, b, sh->stim.fmt, opt->pipeline);
+    return(ANShardRunJob(&job, sh, opt));
+}
@@ -0,0 +1,47 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+/* BATCH.H header file
+ * a batch of many (short) stimuli of any lengths, such as the tone pips and clicks of a
+ * psychophysical experiment, run through the same population.  The stimuli are packed back to
+ * back in one array, and the output of each (the rows of all the fibers, as for a population)
+ * follows that of the one before in another.  Setting up a fiber is paid once per process and
+ * CF rather than per stimulus: the tables of C1 and the filters of the resamplers are kept
+ * from one item to the next (ihcan.c, resample.c), and the items of a fiber are consecutive.
+*/
+
+#include "anmodel.h"
+#include "population.h"
+#include "shard.h"
+
+typedef struct __ANBATCH
+{
+    const ANPOPSPEC *spec;
+    int    nstim, nfib;     /* stimuli, and fibers of the population (ANPopNumItems) */
+    long   maxlen;          /* length of the longest stimulus */
+    long  *inoff;           /* stimulus s is samples inoff[s] to inoff[s+1]-1 of the packed input */
+    long  *outoff;          /* its nfib rows of ANPopOutLength samples start at outoff[s] of the output */
+    const uint64_t *seed;   /* base seed of each stimulus, or NULL (set by ANBatchInit) for those below */
+} ANBATCH;
+
+/* Set up a batch of nstim stimuli of len[s] >= 1 samples */
+int    ANBatchInit(ANBATCH *b, const ANPOPSPEC *spec, int nstim, const long *len);
+void   ANBatchFree(ANBATCH *b);
+
+/* Items are fiber-major (item = fiber*nstim + s), so that the items of a fiber follow one
+   another.  Fiber i of stimulus s is seeded as item s*nfib+i of a population, so stimulus 0
+   gives the rows of ANPopRunItem and every stimulus has its own fGn and spikes; with b->seed,
+   stimulus s gives the rows of a population of base seed b->seed[s] instead. */
+long   ANBatchNumItems(const ANBATCH *b);
+/* Run item on the packed stimuli px and write its row of the packed output out, as
+   ANPopRunItem (skipped may be NULL) */
+int    ANBatchRunItem(const ANBATCH *b, long item, const ANSIGNAL *px, ANSIGNAL *out, ANWORK *work,
+                      struct __ANPIPE *pipe, long *skipped);
+
+/* The job of the batch for stimulus format fmt (see shard.h) */
+void   ANBatchJob(ANSHARDJOB *job, const ANBATCH *b, int fmt, int pipeline);
+/* Run all the items with opt->nworkers processes; sh is created for ANBatchNumItems(b) items
+   of b->inoff[b->nstim] samples, with the packed stimuli and output */
+int    ANBatchRun(const ANBATCH *b, ANSHARED *sh, const ANSHARDOPT *opt);
+
+#endif
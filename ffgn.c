@@ -0,0 +1,172 @@
+/*
+ffgn.c is a native port of ffGn.m: fast (exact) fractional Gaussian noise and Brownian motion
+generator, based on an embedding of the covariance matrix in a circulant matrix.
+
+   References: Davies & Harte (1987); Beran (1994); Bardet et al., 2002
+   Original MATLAB code copyright 2003-2005 by B. Scott Jackson, with revisions by M. S. A. Zilany
+*/
+
+#include <stdlib.h>
+#include <math.h>
+#include "anmodel.h"
+#include "ffgn.h"
+
+/* In-place radix-2 decimation-in-time FFT of length n (a power of 2) */
+static void FFTRadix2(double *re, double *im, long n)
+{
+    long   i, j, k, len, half;
+    double ang, wr, wi, tr, ti, t;
+
+    for (i=1, j=0; i<n; i++)
+    {
+        for (k=n>>1; j&k; k>>=1) j ^= k;
+        j ^= k;
+        if (i<j)
+        {
+            t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (len=2; len<=n; len<<=1)
+    {
+        half = len>>1;
+        ang  = -TWOPI/len;
+        for (k=0; k<half; k++)
+        {
+            wr = cos(ang*k); wi = sin(ang*k);
+            for (i=k; i<n; i+=len)
+            {
+                j  = i+half;
+                tr = wr*re[j] - wi*im[j];
+                ti = wr*im[j] + wi*re[j];
+                re[j] = re[i]-tr; im[j] = im[i]-ti;
+                re[i] += tr;      im[i] += ti;
+            }
+        }
+    }
+}
+
+/* Length of the coarse sequence generated for N samples, and of its circulant embedding */
+static long FFGNCoarse(long N, double tdres, long *Nfft)
+{
+    long n;
+
+    n = (long)ceil((double)N/(int)ceil(1e-1/tdres))+1;
+    if (n<10) n = 10;
+    for (*Nfft=1; *Nfft<2*(n-1); *Nfft *= 2);
+    return(n);
+}
+
+size_t FFGNWorkSize(long N, double tdres, double H)
+{
+    long   ncoarse, Nfft;
+    size_t tmp;
+
+    ncoarse = FFGNCoarse(N, tdres, &Nfft);
+    /* the FFT buffers are given back before the interpolator is set up */
+    tmp = (H==0.5 || H==1.5) ? 0 : 3*ANWorkRound(Nfft*sizeof(double));
+    return(ANWorkRound(ncoarse*sizeof(double)) + __max(tmp, ResamplerWorkSize((int)ceil(1e-1/tdres), 1)));
+}
+
+int FFGNInit(FFGN *g, long N, double tdres, double Hinput, double mu, ANRAND *rng, ANWORK *work)
+{
+    long   k, Nfft, NfftHalf, kk;
+    double H, *zmag, *re, *im;
+    int    fBn, err;
+    size_t mark;
+
+    g->y = NULL; g->up.h = NULL; g->up.buf = NULL;
+    g->work = work; g->up.work = work;
+
+    if (N<=0 || tdres>1 || Hinput<0 || Hinput>2) return(AN_EPARAM);
+
+    /* Downsampling No. of points to match with those of Scott jackson (tau 1e-1) */
+    g->nop    = N;
+    g->resamp = (int)ceil(1e-1/tdres);
+    N = FFGNCoarse(N, tdres, &Nfft);
+    g->ncoarse = N;
+
+    /* Determine whether fGn or fBn should be produced */
+    if (Hinput<=1) { H = Hinput;   fBn = 0; }
+    else           { H = Hinput-1; fBn = 1; }
+
+    g->y = (double*)ANWorkAlloc(work,N*sizeof(double));
+    if (g->y==NULL) return(AN_ENOMEM);
+
+    if (rng==NULL)
+        ;   /* restored from a checkpoint by the caller */
+    else if (H==0.5)
+    {
+        for (k=0; k<N; k++) g->y[k] = ANRandNormal(rng);  /* fGn is equivalent to white Gaussian noise */
+    }
+    else
+    {
+        NfftHalf = Nfft/2;
+
+        /* temporary: given back to the workspace as soon as y is complete */
+        mark = ANWorkMark(work);
+        zmag = (double*)ANWorkAlloc(work,Nfft*sizeof(double));
+        re   = (double*)ANWorkAlloc(work,Nfft*sizeof(double));
+        im   = (double*)ANWorkAlloc(work,Nfft*sizeof(double));
+        if (zmag==NULL || re==NULL || im==NULL)
+        {
+            ANWorkRelease(work,zmag); ANWorkRelease(work,re); ANWorkRelease(work,im);
+            ANWorkReset(work,mark); FFGNFree(g);
+            return(AN_ENOMEM);
+        }
+
+        /* k = [0:NfftHalf, (NfftHalf-1):-1:1] */
+        for (k=0; k<Nfft; k++)
+        {
+            kk = (k<=NfftHalf) ? k : Nfft-k;
+            re[k] = 0.5*(pow(kk+1.0,2.0*H) - 2.0*pow((double)kk,2.0*H) + pow(fabs(kk-1.0),2.0*H));
+            im[k] = 0.0;
+        }
+        FFTRadix2(re, im, Nfft);
+        for (k=0; k<Nfft; k++)
+        {
+            if (re[k]<0)
+            {
+                ANWorkRelease(work,zmag); ANWorkRelease(work,re); ANWorkRelease(work,im);
+                ANWorkReset(work,mark); FFGNFree(g);
+                return(AN_EFGN);
+            }
+            zmag[k] = sqrt(re[k]);
+        }
+
+        /* Z = Zmag.*(randn(1,Nfft) + i.*randn(1,Nfft)); y = real(ifft(Z)).*sqrt(Nfft) */
+        for (k=0; k<Nfft; k++) re[k] = zmag[k]*ANRandNormal(rng);
+        for (k=0; k<Nfft; k++) im[k] = -zmag[k]*ANRandNormal(rng);  /* conjugated: ifft(Z) = conj(fft(conj(Z)))/Nfft */
+        FFTRadix2(re, im, Nfft);
+        for (k=0; k<N; k++) g->y[k] = re[k]/Nfft*sqrt((double)Nfft);
+
+        ANWorkRelease(work,zmag); ANWorkRelease(work,re); ANWorkRelease(work,im);
+        ANWorkReset(work,mark);
+    }
+
+    /* Convert the fGn to fBn, if necessary */
+    if (fBn && rng!=NULL)
+        for (k=1; k<N; k++) g->y[k] += g->y[k-1];
+
+    /* define standard deviation */
+    if (mu<0.5)     g->sigma = 3;
+    else if (mu<18) g->sigma = 30;
+    else            g->sigma = 200;
+
+    /* Resampling back to original (1/tdres): match with the AN model */
+    err = ResamplerInit(&g->up, g->resamp, 1, work);
+    if (err!=AN_OK) { FFGNFree(g); return(err); }
+
+    return(AN_OK);
+}
+
+void FFGNFree(FFGN *g)
+{
+    ANWorkRelease(g->work, g->y); g->y = NULL;
+    ResamplerFree(&g->up);
+}
+
+double FFGNSample(const FFGN *g, long m)
+{
+    return(ResamplerInterp(&g->up, g->y, g->ncoarse, m)*g->sigma);
+}
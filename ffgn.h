@@ -0,0 +1,34 @@
+#ifndef _FFGN_H
+#define _FFGN_H
+
+/* FFGN.H header file
+ * native port of ffGn.m (fast, exact fractional Gaussian noise by circulant embedding, B. Scott Jackson)
+ * as used by the synapse model.  Only the coarse noise sequence is kept in memory; the samples at
+ * the synapse rate are interpolated on demand, so the noise has a "position" that can be checkpointed.
+*/
+
+#include "anmodel.h"
+#include "resample.h"
+
+typedef struct __FFGN
+{
+    long   nop;        /* number of samples requested (at 1/tdres) */
+    long   ncoarse;    /* number of coarse samples actually generated */
+    int    resamp;     /* interpolation factor from the coarse rate back to 1/tdres */
+    double sigma;      /* standard deviation for the fiber's spontaneous rate */
+    double *y;         /* coarse noise sequence */
+    RESAMPLER up;
+    ANWORK *work;      /* workspace of y (NULL for the heap) */
+} FFGN;
+
+/* Generate N samples of fGn with time resolution tdres, Hurst index H, for a fiber of
+   spontaneous rate mu (which sets the standard deviation, as in ffGn.m).  With rng NULL the
+   coarse sequence is only allocated, for a checkpoint to fill in (SynapseInitState). */
+int    FFGNInit(FFGN *g, long N, double tdres, double H, double mu, ANRAND *rng, ANWORK *work);
+/* Bytes taken from the workspace by FFGNInit (including its temporary FFT buffers) */
+size_t FFGNWorkSize(long N, double tdres, double H);
+void   FFGNFree(FFGN *g);
+/* m-th noise sample, 0 <= m < N */
+double FFGNSample(const FFGN *g, long m);
+
+#endif
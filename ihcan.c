@@ -0,0 +1,1312 @@
+/* This is Version 5.2 of the code for auditory periphery model of:
+
+    Zilany, M.S.A., Bruce, I.C., Nelson, P.C., and Carney, L.H. (2009). "A Phenomenological
+        model of the synapse between the inner hair cell and auditory nerve : Long-term adaptation
+        with power-law dynamics," Journal of the Acoustical Society of America 126(5): 2390-2412.
+
+   with the modifications and simulation options described in:
+
+    Zilany, M.S.A., Bruce, I.C., Ibrahim, R.A., and Carney, L.H. (2013). "Improved parameters
+        and expanded simulation options for a model of the auditory periphery,"
+        in Abstracts of the 36th ARO Midwinter Research Meeting.
+
+   Humanization in this version includes:
+   - Human middle-ear filter, based on the linear middle-ear circuit model of Pascal et al. (JASA 1998)
+   - Human BM tuning, based on Shera et al. (PNAS 2002) or Glasberg & Moore (Hear. Res. 1990)
+   - Human frequency-offset of control-path filter (i.e., cochlear amplifier mechanism), based on Greenwood (JASA 1990)
+
+   The modifications to the BM tuning are described in:
+
+        Ibrahim, R. A., and Bruce, I. C. (2010). "Effects of peripheral tuning on the auditory nerve's representation
+            of speech envelope and temporal fine structure cues," in The Neurophysiological Bases of Auditory Perception,
+            eds. E. A. Lopez-Poveda and A. R. Palmer and R. Meddis, Springer, NY, pp. 429438.
+
+   Please cite these papers if you publish any research
+   results obtained with this code or any modified versions of this code.
+
+   See the file readme.txt for details of compiling and running the model.
+
+   %%%  M. S. Arefeen Zilany (msazilany@gmail.com), Ian C. Bruce (ibruce@ieee.org),
+         Rasha A. Ibrahim, Paul C. Nelson, and Laurel H. Carney - November 2013 %%%
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>      /* Added for MS Visual C++ compatability, by Ian Bruce, 1999 */
+
+#include "complex.hpp"
+#include "anmodel.h"
+#include "ihcan.h"
+
+/* Orders of the filter cascades.  They are compile-time constants, and the per-sample filters
+   are static, so that the compiler can unroll the cascades and keep their state in registers */
+#define WB_ORDER   3    /* control-path wideband gammatone filter */
+#define OHC_ORDER  2    /* OHC low-pass filter */
+#define IHC_ORDER  7    /* IHC low-pass filter */
+#define WB_RENORM 64    /* samples between recomputations of the phasor of the control-path filter */
+
+static int IHCANKernel(IHCSTATE *, const double *, double *, long, double *, const int, const int);
+
+static void   C1Setup(C1TABLE *, double, double, double);
+static int    ChirpSections(const C1TABLE *, double, double *);
+static void   C1TableSetup(C1TABLE *, double, double, double, double);
+static double C1TableFit(const C1TABLE *, int, double *);
+static size_t C1TableBytes(const C1TABLE *);
+static void   C1TableCached(C1TABLE *, double, double, double, double, ANWORK *);
+static int    C1Sections(const C1TABLE *, double, double *);
+static double C1ChirpFilt(double, long, double, const C1TABLE *, CHIRPSTATE *);
+static void   ChirpCascade(const double *, long, const double *, CHIRPSTATE *, double *);
+static void   C2ChirpFilt(const double *, long, const C1TABLE *, const double *, CHIRPSTATE *, double *);
+static double WbGammaTone(double, double, double, double, double, WBSTATE *);
+
+double Get_tauwb(double, int, int, double *, double *);
+double Get_taubm(double, int, double, double *, double *, double *);
+double gain_groupdelay(double, double, double, double, int *);
+
+static void   LowPassInit(LPSTATE *, double, double);
+static double OhcLowPass(double, double, LPSTATE *);
+static double MiddleEarStart(IHCSTATE *, double, long, const int);
+static void   MiddleEarBlock(IHCSTATE *, const double *, long, double *, const int);
+static void   IhcLowPassBlock(LPSTATE *, const double *, long, double *);
+double Boltzman(double, double, double, double, double);
+double NLafterohc(double, double, double, double);
+double NLogarithm(double, double, double, double);
+
+int IHCANInit(IHCSTATE *st, double cf, double tdres, double cohc, double cihc, int species, int delayed,
+              ANWORK *work)
+{
+    double bmplace,gain,bmTaubm,delay;
+    double Taumin[1],Taumax[1],bmTaumin[1],bmTaumax[1],ratiobm[1];
+    double fp,C;
+    int    grdelay[1],bmorder;
+
+    memset(st, 0, sizeof(IHCSTATE));
+    st->cf = cf; st->tdres = tdres; st->cohc = cohc; st->cihc = cihc; st->species = species;
+    st->delayed = delayed;
+    st->work    = work;
+    st->silence  = 0;
+    st->quiettol = AN_IHC_QUIETTOL;
+    st->ohcrest  = Boltzman(0.0,7.0,12.0,5.0,5.0);   /* output of the OHC nonlinearity at rest */
+
+    /** Calculate the center frequency for the control-path wideband filter
+        from the location on basilar membrane, based on Greenwood (JASA 1990) */
+
+    if (species==1) /* for cat */
+    {
+        /* Cat frequency shift corresponding to 1.2 mm */
+        bmplace = 11.9 * log10(0.80 + cf / 456.0); /* Calculate the location on basilar membrane from CF */
+        st->centerfreq = 456.0*(pow(10,(bmplace+1.2)/11.9)-0.80); /* shift the center freq */
+    }
+
+    if (species>1) /* for human */
+    {
+        /* Human frequency shift corresponding to 1.2 mm */
+        bmplace = (35/2.1) * log10(1.0 + cf / 165.4); /* Calculate the location on basilar membrane from CF */
+        st->centerfreq = 165.4*(pow(10,(bmplace+1.2)/(35/2.1))-1.0); /* shift the center freq */
+    }
+
+    /*==================================================================*/
+    /*====== Parameters for the gain ===========*/
+
+    if(species==1) gain = 52.0/2.0*(tanh(2.2*log10(cf/0.6e3)+0.15)+1.0); /* for cat */
+    if(species>1) gain = 52.0/2.0*(tanh(2.2*log10(cf/0.6e3)+0.15)+1.0); /* for human */
+    /*gain = 52/2*(tanh(2.2*log10(cf/1e3)+0.15)+1);*/
+    if(gain>60.0) gain = 60.0;
+    if(gain<15.0) gain = 15.0;
+
+    /*====== Parameters for the control-path wideband filter =======*/
+    bmorder = 3;
+    Get_tauwb(cf,species,bmorder,Taumax,Taumin);
+    /*====== Parameters for the signal-path C1 filter ======*/
+    Get_taubm(cf,species,Taumax[0],bmTaumax,bmTaumin,ratiobm);
+    bmTaubm  = cohc*(bmTaumax[0]-bmTaumin[0])+bmTaumin[0];
+    /*====== Parameters for the control-path wideband filter =======*/
+    st->TauWBMax = Taumin[0]+0.2*(Taumax[0]-Taumin[0]);
+    st->TauWBMin = st->TauWBMax/Taumax[0]*Taumin[0];
+    st->tauwb    = st->TauWBMax+(bmTaubm-bmTaumax[0])*(st->TauWBMax-st->TauWBMin)/(bmTaumax[0]-bmTaumin[0]);
+    st->bmTaumax = bmTaumax[0];
+    st->bmTaumin = bmTaumin[0];
+    st->ratiobm  = ratiobm[0];
+
+    /* the coefficients of C1 depend only on its pole shift, which the control path keeps between
+       0 and 1/bmTaumin-1/bmTaumax, so they are tabulated once per fiber (or copied from the
+       table of an earlier fiber of the same CF) */
+    C1TableCached(&st->c1tab,cf,tdres,bmTaumax[0],bmTaumin[0],work);
+    /* C2 has the poles of C1 with the OHC completely impaired; an invalid C2 is reported by the
+       first call of IHCANRun, as before */
+    st->c2.err = ChirpSections(&st->c1tab,-st->c1tab.sigma0/st->ratiobm,st->c2sec);
+    /* With the OHC completely impaired, tauc1 is bmTaumin whatever the control path does, so
+       C1 is also a fixed filter: its coefficients are those C1ChirpFilt would compute on each
+       sample (if they are invalid, the control path runs and reports it) */
+    if (cohc==0)
+    {
+        st->c1rsigma = 1/bmTaumin[0]-1/bmTaumax[0];
+        st->c1fixed  = (C1Sections(&st->c1tab,st->c1rsigma,st->c1sec) == AN_OK);
+    }
+
+    /* The group delay of the control-path filter never exceeds TauWBMax/tdres samples,
+       so the gains it schedules ahead of time fit in a ring of that length */
+    st->ngain   = (int)floor(st->TauWBMax/tdres)+2;
+    st->tmpgain = (double*)ANWorkCalloc(work,st->ngain*sizeof(double));
+
+    st->wbgain = gain_groupdelay(tdres,st->centerfreq,cf,st->tauwb,grdelay);
+    st->tmpgain[0]  = st->wbgain;
+    st->lasttmpgain = st->wbgain;
+
+    LowPassInit(&st->ohc, tdres, 600);   /* lowpass filtering after the OHC nonlinearity */
+    LowPassInit(&st->ihc, tdres, 3000);  /* IHC lowpass filtering */
+    /*===============================================================*/
+    /* Prewarping and related constants for the middle ear */
+     fp = 1e3;  /* prewarping frequency 1 kHz */
+     C  = TWOPI*fp/tan(TWOPI/2*fp*tdres);
+     if (species==1) /* for cat */
+     {
+         /* Cat middle-ear filter - simplified version from Bruce et al. (JASA 2003) */
+         st->m11 = C/(C + 693.48);                    st->m12 = (693.48 - C)/C;            st->m13 = 0.0;
+         st->m14 = 1.0;                               st->m15 = -1.0;                      st->m16 = 0.0;
+         st->m21 = 1/(pow(C,2) + 11053*C + 1.163e8);  st->m22 = -2*pow(C,2) + 2.326e8;     st->m23 = pow(C,2) - 11053*C + 1.163e8;
+         st->m24 = pow(C,2) + 1356.3*C + 7.4417e8;    st->m25 = -2*pow(C,2) + 14.8834e8;   st->m26 = pow(C,2) - 1356.3*C + 7.4417e8;
+         st->m31 = 1/(pow(C,2) + 4620*C + 909059944); st->m32 = -2*pow(C,2) + 2*909059944; st->m33 = pow(C,2) - 4620*C + 909059944;
+         st->m34 = 5.7585e5*C + 7.1665e7;             st->m35 = 14.333e7;                  st->m36 = 7.1665e7 - 5.7585e5*C;
+         st->megainmax=41.1405;
+     };
+     if (species>1) /* for human */
+     {
+         /* Human middle-ear filter - based on Pascal et al. (JASA 1998)  */
+         st->m11=1/(pow(C,2)+5.9761e+003*C+2.5255e+007);st->m12=(-2*pow(C,2)+2*2.5255e+007);st->m13=(pow(C,2)-5.9761e+003*C+2.5255e+007);st->m14=(pow(C,2)+5.6665e+003*C);             st->m15=-2*pow(C,2);                 st->m16=(pow(C,2)-5.6665e+003*C);
+         st->m21=1/(pow(C,2)+6.4255e+003*C+1.3975e+008);st->m22=(-2*pow(C,2)+2*1.3975e+008);st->m23=(pow(C,2)-6.4255e+003*C+1.3975e+008);st->m24=(pow(C,2)+5.8934e+003*C+1.7926e+008); st->m25=(-2*pow(C,2)+2*1.7926e+008); st->m26=(pow(C,2)-5.8934e+003*C+1.7926e+008);
+         st->m31=1/(pow(C,2)+2.4891e+004*C+1.2700e+009);st->m32=(-2*pow(C,2)+2*1.2700e+009);st->m33=(pow(C,2)-2.4891e+004*C+1.2700e+009);st->m34=(3.1137e+003*C+6.9768e+008);     st->m35=2*6.9768e+008;                st->m36=(-3.1137e+003*C+6.9768e+008);
+         st->megainmax=2;
+     };
+
+    /* Adjust total path delay to IHC output signal */
+    if (species==1)
+        delay      = delay_cat(cf);
+    if (species>1)
+    {/*    delay      = delay_human(cf); */
+        delay      = delay_cat(cf); /* signal delay changed back to cat function for version 5.2 */
+    };
+    st->delaypoint =__max(0,(int) ceil(delay/tdres));
+
+    if (delayed && st->delaypoint>0)
+        st->delayline = (double*)ANWorkCalloc(work,st->delaypoint*sizeof(double));
+
+    if (st->tmpgain==NULL || (delayed && st->delaypoint>0 && st->delayline==NULL)
+        || (st->c1tab.n>0 && st->c1tab.coef==NULL))
+    {
+        IHCANFree(st);
+        return(AN_ENOMEM);
+    }
+    return(AN_OK);
+}
+
+void IHCANFree(IHCSTATE *st)
+{
+    ANWorkRelease(st->work, st->tmpgain);   st->tmpgain = NULL;
+    ANWorkRelease(st->work, st->delayline); st->delayline = NULL;
+    ANWorkRelease(st->work, st->c1tab.coef); st->c1tab.coef = NULL;
+}
+
+size_t IHCANWorkSize(double cf, double tdres, int species, int delayed)
+{
+    double Taumin[1], Taumax[1], bmTaumax[1], bmTaumin[1], ratiobm[1], TauWBMax;
+    int    ngain, delaypoint;
+    C1TABLE c1tab;
+
+    /* as in IHCANInit (the delay is the cat one for all species since version 5.2) */
+    Get_tauwb(cf,species,3,Taumax,Taumin);
+    Get_taubm(cf,species,Taumax[0],bmTaumax,bmTaumin,ratiobm);
+    C1TableSetup(&c1tab,cf,tdres,bmTaumax[0],bmTaumin[0]);
+    TauWBMax   = Taumin[0]+0.2*(Taumax[0]-Taumin[0]);
+    ngain      = (int)floor(TauWBMax/tdres)+2;
+    delaypoint = __max(0,(int) ceil(delay_cat(cf)/tdres));
+    return(ANWorkRound(ngain*sizeof(double)) + (delayed ? ANWorkRound(delaypoint*sizeof(double)) : 0)
+           + ANWorkRound(C1TableBytes(&c1tab)));
+}
+
+/* Parts of the per-sample loop run by a call */
+#define IHC_CONTROL 1   /* middle ear and control path, up to the pole shift rsigma of C1, and C2 */
+#define IHC_C1      2   /* C1 filter */
+#define IHC_IHC     4   /* IHC transduction (the only part that depends on cihc) and low-pass, path delay */
+#define IHC_SIGNAL  (IHC_C1|IHC_IHC)
+#define IHC_ALL     (IHC_CONTROL|IHC_SIGNAL)
+#define IHC_BLOCK 256   /* samples per block */
+
+int IHCANRun(IHCSTATE *st, const double *px, long nsamp, double *ihcout)
+{
+    /* the species is dispatched once per call: human (species 2 and 3, which differ only in
+       the tuning set up by IHCANInit) and cat each get their own copy of the loop */
+    if (st->species>1) return(IHCANKernel(st, px, NULL, nsamp, ihcout, 1, IHC_ALL));
+    return(IHCANKernel(st, px, NULL, nsamp, ihcout, 0, IHC_ALL));
+}
+
+int IHCANRunControl(IHCSTATE *st, const double *px, long nsamp, double *ctl)
+{
+    if (st->species>1) return(IHCANKernel(st, px, ctl, nsamp, NULL, 1, IHC_CONTROL));
+    return(IHCANKernel(st, px, ctl, nsamp, NULL, 0, IHC_CONTROL));
+}
+
+int IHCANRunSignal(IHCSTATE *st, const double *ctl, long nsamp, double *ihcout)
+{
+    return(IHCANKernel(st, NULL, (double*)ctl, nsamp, ihcout, 0, IHC_SIGNAL));
+}
+
+int IHCANRunPre(IHCSTATE *st, const double *px, long nsamp, double *pre)
+{
+    if (st->species>1) return(IHCANKernel(st, px, pre, nsamp, NULL, 1, IHC_CONTROL|IHC_C1));
+    return(IHCANKernel(st, px, pre, nsamp, NULL, 0, IHC_CONTROL|IHC_C1));
+}
+
+int IHCANRunPost(IHCSTATE *st, const double *pre, long nsamp, double *ihcout)
+{
+    return(IHCANKernel(st, NULL, (double*)pre, nsamp, ihcout, 0, IHC_IHC));
+}
+
+/* The memories of a chirp filter are all within tol of zero */
+static int ChirpQuiet(const CHIRPSTATE *c, double tol)
+{
+    int i, j;
+
+    for (i=0; i<12; i++)
+        for (j=0; j<4; j++)
+            if (fabs(c->input[i][j])>tol || fabs(c->output[i][j])>tol) return(0);
+    return(1);
+}
+
+/* The middle ear, the control-path filter and C2 have decayed to within st->quiettol of rest
+   (zero, and ohcrest for the OHC low-pass; the control-path filter and the OHC low-pass do not
+   count when C1 is fixed, as they do not run) */
+static int IHCQuietControl(const IHCSTATE *st)
+{
+    double tol = st->quiettol;
+    int    i;
+
+    if (st->n<2 || tol<=0) return(0);
+    if (fabs(st->px1)>tol || fabs(st->px2)>tol) return(0);
+    for (i=0; i<2; i++)
+        if (fabs(st->mey1[i])>tol || fabs(st->mey2[i])>tol || fabs(st->mey3[i])>tol) return(0);
+    if (st->c1fixed) return(ChirpQuiet(&st->c2, tol));
+    for (i=0; i<=WB_ORDER; i++)
+        if (fabs(st->wb.gtf[i].x)>tol || fabs(st->wb.gtf[i].y)>tol
+            || fabs(st->wb.gtfl[i].x)>tol || fabs(st->wb.gtfl[i].y)>tol) return(0);
+    for (i=0; i<=OHC_ORDER; i++)
+        if (fabs(st->ohc.y[i]-st->ohcrest)>tol || fabs(st->ohc.yl[i]-st->ohcrest)>tol) return(0);
+    return(ChirpQuiet(&st->c2, tol));
+}
+
+/* Advance the settled control path over nb samples of silence: its memories go to rest and the
+   phase of the frequency shift moves on sample by sample, as in WbGammaTone, so that it does not
+   depend on how the silence is split into calls */
+static void IHCSettleControl(IHCSTATE *st, long nb)
+{
+    double delta_phase = -TWOPI*st->centerfreq*st->tdres;
+    long   j;
+    int    i;
+
+    st->px1 = 0; st->px2 = 0;
+    memset(st->mey1, 0, sizeof(st->mey1));
+    memset(st->mey2, 0, sizeof(st->mey2));
+    memset(st->mey3, 0, sizeof(st->mey3));
+    memset(st->wb.gtf, 0, sizeof(st->wb.gtf));
+    memset(st->wb.gtfl, 0, sizeof(st->wb.gtfl));
+    memset(st->c2.input, 0, sizeof(st->c2.input));
+    memset(st->c2.output, 0, sizeof(st->c2.output));
+    for (i=0; i<=OHC_ORDER; i++) st->ohc.y[i] = st->ohc.yl[i] = st->ohcrest;
+    for (j=0; j<nb; j++)
+    {
+        st->wb.phase += delta_phase;
+        if (st->wb.phase < -TWOPI/2) st->wb.phase += TWOPI;
+        if (st->wb.phase >  TWOPI/2) st->wb.phase -= TWOPI;
+    }
+    st->wb.nrot  = 0;   /* the phasor is recomputed from the phase on the next sample */
+}
+
+/* The filters of the parts of the signal path run by a call (C1 and the IHC low-pass) have
+   decayed to within st->quiettol of zero.  Without the IHC (IHCANRunPre), whose low-pass would
+   show what is left of C1, it is the output of C1 that has to be within st->quiettol. */
+static int IHCQuietSignal(const IHCSTATE *st, int part)
+{
+    double tol = st->quiettol;
+    int    i;
+
+    if (st->n<1 || tol<=0) return(0);
+    if ((part & IHC_C1) && !ChirpQuiet(&st->c1, (part & IHC_IHC) ? tol : tol*4.0/st->c1tab.norm_gain)) return(0);
+    if (part & IHC_IHC)
+        for (i=0; i<=IHC_ORDER; i++)
+            if (fabs(st->ihc.y[i])>tol || fabs(st->ihc.yl[i])>tol) return(0);
+    return(1);
+}
+
+/* The loop over the samples, in blocks: the middle ear (which is linear and time-invariant)
+   runs over the block, the control path sample by sample, then C2 (also linear and
+   time-invariant), C1, the IHC and the path delay over the block.  human and part are
+   constants at each call, so their tests are resolved at compile time.  Between the parts,
+   ctl holds meout, rsigma and the C2 output of each sample, or after C1 (IHCANRunPre) the C1
+   output and the C2 transduction output.  Silence is fast-forwarded by each part from the
+   start of a block at which its filters have decayed (see ihcan.h); the blocks are aligned to
+   the samples of the stimulus rather than to the call, and the block is cut short where the
+   silence of the control part ends. */
+static int IHCANKernel(IHCSTATE *st, const double *px, double *ctl, long nsamp, double *ihcout, const int human, const int part)
+{
+    double c1vihctmp, c2vihctmp;
+    double me[IHC_BLOCK], rs[IHC_BLOCK], c1out[IHC_BLOCK], c2out[IHC_BLOCK], *sx;
+
+    /*variables for the signal-path, control-path and onward */
+    double cf = st->cf, tdres = st->tdres, cohc = st->cohc, cihc = st->cihc;
+    double TauWBMax = st->TauWBMax, TauWBMin = st->TauWBMin, bmTaumax = st->bmTaumax, bmTaumin = st->bmTaumin;
+    double ohcasym, ihcasym, wbout1, wbout, ohcnonlinout, ohcout, tmptauc1, tauc1, rsigma, wb_gain;
+    int    grd, grdelay[1], slot;
+    long   i, j, j0, n, i0, nb;
+
+    /*===============================================================*/
+    /* Nonlinear asymmetry of OHC function and IHC C1 transduction function*/
+    ohcasym  = 7.0;
+    ihcasym  = 3.0;
+    /*===============================================================*/
+
+    if (st->c2.err) return(st->c2.err);
+
+    for (i0=0; i0<nsamp; i0+=nb)  /* Start of the loop over blocks */
+    {
+        nb = __min(IHC_BLOCK-st->n%IHC_BLOCK, nsamp-i0);
+
+        /* the control part fast-forwards the silent samples from the start of the block */
+        j0 = 0;
+        if (part & IHC_CONTROL)
+        {
+            if (st->n%IHC_BLOCK==0) st->quietctl = IHCQuietControl(st);
+            while (st->quietctl && j0<nb && fabs(px[i0+j0])<=st->silence) j0++;
+            if (j0<nb) st->quietctl = 0;    /* until the next block */
+            if (j0>0)  nb = j0;
+        }
+
+        if (j0>0)
+        {
+            /* silence, and the control path has settled: the middle ear, the control-path
+               filter and C2 stay at zero and the OHC low-pass at rest, so only the gain
+               schedule and the phase advance */
+            IHCSettleControl(st, nb);
+            ohcout   = st->ohc.y[OHC_ORDER];
+            tmptauc1 = NLafterohc(ohcout,bmTaumin,bmTaumax,ohcasym);
+            tauc1    = cohc*(tmptauc1-bmTaumin)+bmTaumin;
+            rsigma   = 1/tauc1-1/bmTaumax;
+            st->tauwb = TauWBMax+(tauc1-bmTaumax)*(TauWBMax-TauWBMin)/(bmTaumax-bmTaumin);
+            wb_gain  = gain_groupdelay(tdres,st->centerfreq,cf,st->tauwb,grdelay);
+            grd      = grdelay[0];
+            for (j=0; j<nb; j++)
+            {
+                n = st->n+j;
+                if (grd>=0 && grd<st->ngain)
+                     st->tmpgain[(n+grd)%st->ngain] = wb_gain;
+                slot = (int)(n%st->ngain);
+                if (st->tmpgain[slot] == 0)
+                    st->tmpgain[slot] = st->lasttmpgain;
+                st->wbgain      = st->tmpgain[slot];
+                st->lasttmpgain = st->wbgain;
+                st->tmpgain[slot] = 0;
+                me[j] = 0; rs[j] = rsigma; c2out[j] = 0;
+            }
+            st->skipctl += nb;
+        }
+        else if ((part & IHC_CONTROL) && st->c1fixed)
+        {
+            /* OHC completely impaired: the control path does not affect C1, so only the middle
+               ear and C2 run */
+            MiddleEarBlock(st, px+i0, nb, me, human);
+            for (j=0; j<nb; j++) rs[j] = st->c1rsigma;
+            C2ChirpFilt(me, nb, &st->c1tab, st->c2sec, &st->c2, c2out);
+        }
+        else if (part & IHC_CONTROL)
+        {
+            /*====== Middle-ear filter: linear and time-invariant, so it runs over the block ======*/
+
+            MiddleEarBlock(st, px+i0, nb, me, human);
+
+            for (j=0; j<nb; j++) /* Start of the loop over the samples of the control path */
+            {
+                n = st->n+j;
+
+                /* Control-path filter */
+
+                wbout1 = WbGammaTone(me[j],tdres,st->centerfreq,st->tauwb,st->wbgain,&st->wb);
+                wbout  = pow((st->tauwb/TauWBMax),WB_ORDER)*wbout1*10e3*__max(1,cf/5e3);
+
+                ohcnonlinout = Boltzman(wbout,ohcasym,12.0,5.0,5.0); /* pass the control signal through OHC Nonlinear Function */
+                ohcout = OhcLowPass(ohcnonlinout,1.0,&st->ohc);/* lowpass filtering after the OHC nonlinearity */
+
+                tmptauc1 = NLafterohc(ohcout,bmTaumin,bmTaumax,ohcasym); /* nonlinear function after OHC low-pass filter */
+                tauc1    = cohc*(tmptauc1-bmTaumin)+bmTaumin;  /* time -constant for the signal-path C1 filter */
+                rsigma   = 1/tauc1-1/bmTaumax; /* shift of the location of poles of the C1 filter from the initial positions */
+
+                if (1/tauc1<0.0) return(AN_EUNSTABLE);
+
+                st->tauwb = TauWBMax+(tauc1-bmTaumax)*(TauWBMax-TauWBMin)/(bmTaumax-bmTaumin);
+
+                wb_gain = gain_groupdelay(tdres,st->centerfreq,cf,st->tauwb,grdelay);
+
+                grd = grdelay[0];
+
+                /* tmpgain is a ring of the next ngain samples; a slot is cleared once it has been used */
+                if (grd>=0 && grd<st->ngain)
+                     st->tmpgain[(n+grd)%st->ngain] = wb_gain;
+
+                slot = (int)(n%st->ngain);
+                if (st->tmpgain[slot] == 0)
+                    st->tmpgain[slot] = st->lasttmpgain;
+
+                st->wbgain      = st->tmpgain[slot];
+                st->lasttmpgain = st->wbgain;
+                st->tmpgain[slot] = 0;
+
+                rs[j] = rsigma;
+            }
+
+            /*====== Parallel-path C2 filter: linear and time-invariant, so it runs over the block ======*/
+
+            C2ChirpFilt(me, nb, &st->c1tab, st->c2sec, &st->c2, c2out);
+        }
+        else if (part & IHC_C1)
+            for (j=0; j<nb; j++)
+            {
+                i = i0+j;
+                me[j] = ctl[3*i]; rs[j] = ctl[3*i+1]; c2out[j] = ctl[3*i+2];
+            }
+        else
+            for (j=0; j<nb; j++)
+            {
+                i = i0+j;
+                c1out[j] = ctl[2*i]; c2out[j] = ctl[2*i+1];
+            }
+
+        if (!(part & IHC_SIGNAL))
+        {
+            for (j=0; j<nb; j++)
+            {
+                i = i0+j;
+                ctl[3*i] = me[j]; ctl[3*i+1] = rs[j]; ctl[3*i+2] = c2out[j];
+            }
+            st->n += nb;
+            continue;
+        }
+
+        /* the signal part fast-forwards the samples from the start of the block at which nothing
+           reaches C1 or the IHC (its input, meout or the C1 output, and the C2 output are zero) */
+        if (st->n%IHC_BLOCK==0) st->quietsig = IHCQuietSignal(st, part);
+        sx = (part & IHC_C1) ? me : c1out;
+        for (j0=0; st->quietsig && j0<nb && sx[j0]==0 && c2out[j0]==0; j0++);
+        if (j0<nb) st->quietsig = 0;
+
+        if (j0>0)
+        {
+            /* their memories have decayed: the output is zero */
+            if (part & IHC_C1)
+            {
+                memset(st->c1.input, 0, sizeof(st->c1.input));
+                memset(st->c1.output, 0, sizeof(st->c1.output));
+            }
+            if (part & IHC_IHC)
+            {
+                memset(st->ihc.y, 0, sizeof(st->ihc.y));
+                memset(st->ihc.yl, 0, sizeof(st->ihc.yl));
+            }
+            for (j=0; j<j0; j++)
+            {
+                i = i0+j;
+                if (!(part & IHC_IHC))
+                    ctl[2*i] = ctl[2*i+1] = 0;
+                else if (st->delayline!=NULL)
+                {
+                    ihcout[i] = st->delayline[st->dpos];
+                    st->delayline[st->dpos] = 0;
+                    st->dpos = (st->dpos+1)%st->delaypoint;
+                }
+                else
+                    ihcout[i] = 0;
+            }
+            st->skipsig += j0;
+            if (j0==nb)
+            {
+                st->n += nb;
+                continue;
+            }
+        }
+
+        /*====== Signal-path C1 filter ======*/
+
+        if (!(part & IHC_C1))
+            ;   /* c1out is the output of IHCANRunPre */
+        else if (st->c1fixed)
+        {
+            /* fixed coefficients (OHC completely impaired): a cascade over the block, as C2 */
+            if (st->n+j0==0)
+            {
+                st->c1.initphase = st->c1tab.initphase;
+                st->c1.gain_norm = st->c1tab.gain_norm;
+            }
+            ChirpCascade(me+j0, nb-j0, st->c1sec, &st->c1, c1out+j0);
+            for (j=j0; j<nb; j++)
+                c1out[j] = c1out[j]*st->c1tab.norm_gain/4.0;
+        }
+        else
+            for (j=j0; j<nb; j++)
+            {
+                c1out[j] = C1ChirpFilt(me[j], st->n+j, rs[j], &st->c1tab, &st->c1); /* C1 filter output */
+                if (st->c1.err) return(st->c1.err);
+            }
+
+        if (!(part & IHC_IHC))
+        {
+            for (j=j0; j<nb; j++)
+            {
+                i = i0+j;
+                ctl[2*i]   = c1out[j];
+                ctl[2*i+1] = -NLogarithm(c2out[j]*fabs(c2out[j])*cf/10*cf/2e3,0.2,1.0,cf); /* C2 transduction output */
+            }
+            st->n += nb;
+            continue;
+        }
+
+        /*=== Run the inner hair cell (IHC) section: NL function and then lowpass filtering ===*/
+
+        for (j=j0; j<nb; j++)
+        {
+            c1vihctmp  = NLogarithm(cihc*c1out[j],0.1,ihcasym,cf);
+
+            if (part & IHC_C1)
+                c2vihctmp = -NLogarithm(c2out[j]*fabs(c2out[j])*cf/10*cf/2e3,0.2,1.0,cf); /* C2 transduction output */
+            else
+                c2vihctmp = c2out[j];   /* from IHCANRunPre, which does not depend on cihc */
+
+            c1out[j] = c1vihctmp+c2vihctmp;
+        }
+        IhcLowPassBlock(&st->ihc, c1out+j0, nb-j0, c1out+j0);
+
+        for (j=j0; j<nb; j++)
+        {
+            i = i0+j;
+
+            /* Adjust total path delay to IHC output signal */
+            if (st->delayline!=NULL)
+            {
+                ihcout[i] = st->delayline[st->dpos];
+                st->delayline[st->dpos] = c1out[j];
+                st->dpos = (st->dpos+1)%st->delaypoint;
+            }
+            else
+                ihcout[i] = c1out[j];
+        }
+        st->n += nb;
+    };  /* End of the loop */
+
+    return(AN_OK);
+} /* End of the IHCANKernel function */
+/* -------------------------------------------------------------------------------------------- */
+/* Checkpoints: the fixed part of IHCSTATE is stored as it is, followed by the ring buffers */
+
+void IHCANSaveState(const IHCSTATE *st, ANBLOB *blob)
+{
+    ANBlobPutHeader(blob, AN_TAG_IHC, sizeof(IHCSTATE));
+    ANBlobPut(blob, st, sizeof(IHCSTATE));
+    ANBlobPut(blob, st->tmpgain, st->ngain*sizeof(double));
+    if (st->delayline!=NULL)
+        ANBlobPut(blob, st->delayline, st->delaypoint*sizeof(double));
+}
+
+int IHCANLoadState(IHCSTATE *st, ANBLOB *blob)
+{
+    IHCSTATE saved;
+
+    if (ANBlobCheckHeader(blob, AN_TAG_IHC, sizeof(IHCSTATE))!=AN_OK) return(blob->err);
+    ANBlobGet(blob, &saved, sizeof(IHCSTATE));
+    if (blob->err) return(blob->err);
+
+    /* The checkpoint must come from the same fiber */
+    if (saved.cf!=st->cf || saved.tdres!=st->tdres || saved.cohc!=st->cohc || saved.cihc!=st->cihc
+        || saved.species!=st->species || saved.delayed!=st->delayed
+        || saved.ngain!=st->ngain || saved.delaypoint!=st->delaypoint || saved.c1tab.n!=st->c1tab.n)
+        return(AN_ESTATE);
+
+    saved.tmpgain   = st->tmpgain;
+    saved.delayline = st->delayline;
+    saved.work      = st->work;
+    saved.c1tab     = st->c1tab;
+    *st = saved;
+    ANBlobGet(blob, st->tmpgain, st->ngain*sizeof(double));
+    if (st->delayline!=NULL)
+        ANBlobGet(blob, st->delayline, st->delaypoint*sizeof(double));
+    return(blob->err);
+}
+/* -------------------------------------------------------------------------------------------- */
+/** Get TauMax, TauMin for the tuning filter. The TauMax is determined by the bandwidth/Q10
+    of the tuning filter at low level. The TauMin is determined by the gain change between high
+    and low level */
+
+double Get_tauwb(double cf, int species, int order, double *taumax,double *taumin)
+{
+  double Q10,bw,gain,ratio;
+
+  if(species==1) gain = 52.0/2.0*(tanh(2.2*log10(cf/0.6e3)+0.15)+1.0); /* for cat */
+  if(species>1) gain = 52.0/2.0*(tanh(2.2*log10(cf/0.6e3)+0.15)+1.0); /* for human */
+  /*gain = 52/2*(tanh(2.2*log10(cf/1e3)+0.15)+1);*/ /* older values */
+
+  if(gain>60.0) gain = 60.0;
+  if(gain<15.0) gain = 15.0;
+
+  ratio = pow(10,(-gain/(20.0*order)));       /* ratio of TauMin/TauMax according to the gain, order */
+  if (species==1) /* cat Q10 values */
+  {
+    Q10 = pow(10,0.4708*log10(cf/1e3)+0.4664);
+  }
+  if (species==2) /* human Q10 values from Shera et al. (PNAS 2002) */
+  {
+    Q10 = pow((cf/1000),0.3)*12.7*0.505+0.2085;
+  }
+  if (species==3) /* human Q10 values from Glasberg & Moore (Hear. Res. 1990) */
+  {
+    Q10 = cf/24.7/(4.37*(cf/1000)+1)*0.505+0.2085;
+  }
+  bw     = cf/Q10;
+  taumax[0] = 2.0/(TWOPI*bw);
+
+  taumin[0]   = taumax[0]*ratio;
+
+  return 0;
+}
+/* -------------------------------------------------------------------------------------------- */
+double Get_taubm(double cf, int species, double taumax,double *bmTaumax,double *bmTaumin, double *ratio)
+{
+  double gain,factor,bwfactor;
+
+  if(species==1) gain = 52.0/2.0*(tanh(2.2*log10(cf/0.6e3)+0.15)+1.0); /* for cat */
+  if(species>1) gain = 52.0/2.0*(tanh(2.2*log10(cf/0.6e3)+0.15)+1.0); /* for human */
+  /*gain = 52/2*(tanh(2.2*log10(cf/1e3)+0.15)+1);*/ /* older values */
+
+
+  if(gain>60.0) gain = 60.0;
+  if(gain<15.0) gain = 15.0;
+
+  bwfactor = 0.7;
+  factor   = 2.5;
+
+  ratio[0]  = pow(10,(-gain/(20.0*factor)));
+
+  bmTaumax[0] = taumax/bwfactor;
+  bmTaumin[0] = bmTaumax[0]*ratio[0];
+  return 0;
+}
+/* -------------------------------------------------------------------------------------------- */
+/** Pass the signal through the signal-path C1 Tenth Order Nonlinear Chirp-Gammatone Filter */
+
+/* Constants of C1 (the locations of the poles and zeros before the shift) */
+static void C1Setup(C1TABLE *t, double cf, double tdres, double taumax)
+{
+    double p1x, p3x, p5x, p1y, p3y, p5y;
+
+    t->sigma0 = 1/taumax;
+    t->ipw    = 1.01*cf*TWOPI-50;
+    t->ipb    = 0.2343*TWOPI*cf-1104;
+    t->rpa    = pow(10, log10(cf)*0.9 + 0.55)+ 2000;
+    t->rzero0 = -(pow(10,log10(cf)*0.7+1.6)+500);
+    t->fsb    = TWOPI*cf/tan(TWOPI*cf*tdres/2);
+    t->CF     = TWOPI*cf;
+
+    p1x = -t->sigma0;         p1y = t->ipw;
+    p5x = p1x - t->rpa;       p5y = p1y - t->ipb;
+    p3x = (p1x + p5x) * 0.5;  p3y = (p1y + p5y) * 0.5;
+
+    /* the sections are p1, p3, p5, p1, p5 (p7 = p1 and p9 = p5), each with its conjugate */
+    t->initphase = 2*(atan(t->CF/(-t->rzero0))-atan((t->CF-p1y)/(-p1x))-atan((t->CF+p1y)/(-p1x)))
+                   + atan(t->CF/(-t->rzero0))-atan((t->CF-p3y)/(-p3x))-atan((t->CF+p3y)/(-p3x))
+                   + 2*(atan(t->CF/(-t->rzero0))-atan((t->CF-p5y)/(-p5x))-atan((t->CF+p5y)/(-p5x)));
+    t->gain_norm = pow(((t->CF-p1y)*(t->CF-p1y) + p1x*p1x)*((t->CF+p1y)*(t->CF+p1y) + p1x*p1x), 2)
+                   * ((t->CF-p3y)*(t->CF-p3y) + p3x*p3x)*((t->CF+p3y)*(t->CF+p3y) + p3x*p3x)
+                   * pow(((t->CF-p5y)*(t->CF-p5y) + p5x*p5x)*((t->CF+p5y)*(t->CF+p5y) + p5x*p5x), 2);
+    t->norm_gain = sqrt(t->gain_norm)/pow(sqrt(t->CF*t->CF+t->rzero0*t->rzero0),5);
+}
+
+/* The coefficients {b0,b1,b2,a1,a2} of the sections p1, p3 and p5 of C1 or C2 when the real
+   part of p1 is p1x (-sigma0-rsigma for C1): the zero moves so that the phase at CF stays at
+   that of the unshifted filter */
+static int ChirpSections(const C1TABLE *t, double p1x, double *sec)
+{
+    double px[3], py[3], phase, rzero, temp, fsb = t->fsb;
+    int    j;
+
+    px[0] = p1x;
+    if (px[0]>0.0) return(AN_EUNSTABLE);
+    py[0] = t->ipw;
+    px[2] = px[0] - t->rpa;         py[2] = py[0] - t->ipb;
+    px[1] = (px[0] + px[2]) * 0.5;  py[1] = (py[0] + py[2]) * 0.5;
+
+    phase = 0.0;
+    for (j=0; j<3; j++)
+        phase -= ((j==1) ? 1 : 2)*(atan((t->CF-py[j])/(-px[j]))+atan((t->CF+py[j])/(-px[j])));
+
+    rzero = -t->CF/tan((t->initphase-phase)/5);
+    if (rzero>0.0) return(AN_EZEROS);
+
+    for (j=0; j<3; j++)
+    {
+        temp = (fsb-px[j])*(fsb-px[j]) + py[j]*py[j];
+        sec[5*j]   = (fsb-rzero)/temp;
+        sec[5*j+1] = -2*rzero/temp;
+        sec[5*j+2] = -(fsb+rzero)/temp;
+        sec[5*j+3] = 2*(fsb*fsb-px[j]*px[j]-py[j]*py[j])/temp;
+        sec[5*j+4] = -((fsb+px[j])*(fsb+px[j])+py[j]*py[j])/temp;
+    }
+    return(AN_OK);
+}
+
+/* Fit the cubics of n intervals of log(sigma0+rsigma) = -log(tauc1) over [t->lo,t->hi] through
+   the coefficients at t = 0, 1/3, 2/3 and 1 of each interval (into coef, unless it is NULL), and return the largest error at
+   t = 1/6, 1/2 and 5/6 relative to the largest coefficient of its kind (HUGE_VAL if the
+   filter is not valid over the whole range) */
+static double C1TableFit(const C1TABLE *t, int n, double *coef)
+{
+    static const double tc[3] = {1.0/6, 0.5, 5.0/6};
+    double h = (t->hi - t->lo)/n, f[4][AN_C1_NCOEF], c[4][AN_C1_NCOEF], exact[AN_C1_NCOEF];
+    double v, big, err, maxerr = 0;
+    int    k, d, j, m;
+
+    for (k=0; k<n; k++)
+    {
+        for (d=0; d<4; d++)
+            if (ChirpSections(t, -exp(t->lo + (k + d/3.0)*h), f[d]) != AN_OK) return(HUGE_VAL);
+        for (j=0; j<AN_C1_NCOEF; j++)
+        {
+            c[0][j] = f[0][j];
+            c[1][j] = (-11*f[0][j] + 18*f[1][j] - 9*f[2][j] + 2*f[3][j])/2;
+            c[2][j] = 9*(2*f[0][j] - 5*f[1][j] + 4*f[2][j] - f[3][j])/2;
+            c[3][j] = 9*(-f[0][j] + 3*f[1][j] - 3*f[2][j] + f[3][j])/2;
+        }
+        for (m=0; m<3; m++)
+        {
+            if (ChirpSections(t, -exp(t->lo + (k + tc[m])*h), exact) != AN_OK) return(HUGE_VAL);
+            for (j=0; j<AN_C1_NCOEF; j++)
+            {
+                v   = c[0][j] + tc[m]*(c[1][j] + tc[m]*(c[2][j] + tc[m]*c[3][j]));
+                big = (j%5<3) ? __max(__max(fabs(exact[j-j%5]), fabs(exact[j-j%5+1])), fabs(exact[j-j%5+2]))
+                              : __max(fabs(exact[j-j%5+3]), fabs(exact[j-j%5+4]));
+                err = fabs(v-exact[j])/big;
+                if (err>maxerr) maxerr = err;
+            }
+        }
+        if (coef!=NULL)
+            for (d=0; d<4; d++)
+                for (j=0; j<AN_C1_NCOEF; j++) coef[(4*k+d)*AN_C1_NCOEF+j] = c[d][j];
+    }
+    return(maxerr);
+}
+
+/* Set up C1 and the number of intervals of its table (doubled from 4 until the fit is within
+   AN_C1_TOL, 0 if AN_C1_MAXTAB is not enough).  The coefficients change fastest for small
+   shifts, so the table is uniform in the log of the time constant tauc1 rather than in rsigma. */
+static void C1TableSetup(C1TABLE *t, double cf, double tdres, double taumax, double taumin)
+{
+    C1Setup(t, cf, tdres, taumax);
+    t->lo = log(1/taumax);
+    t->hi = log(1/taumin);
+    for (t->n=4; t->n<=AN_C1_MAXTAB && C1TableFit(t, t->n, NULL)>AN_C1_TOL; t->n*=2);
+    if (t->n>AN_C1_MAXTAB || t->hi<=t->lo) t->n = 0;
+    t->scale = (t->n>0) ? t->n/(t->hi - t->lo) : 0;
+    t->coef  = NULL;
+}
+
+static size_t C1TableBytes(const C1TABLE *t)
+{
+    return((size_t)t->n*4*AN_C1_NCOEF*sizeof(double));
+}
+
+/* C1TableSetup and C1TableFit, with coef taken from work.  The table depends only on cf, tdres
+   and the range of tauc1, so the last few tables are kept, and runs of many stimuli at a few
+   CFs fit each one once (each worker process keeps its own; not thread-safe).  On a failed
+   allocation coef is NULL, as IHCANInit checks. */
+static void C1TableCached(C1TABLE *t, double cf, double tdres, double taumax, double taumin, ANWORK *work)
+{
+    static struct { double cf, tdres, taumax, taumin; C1TABLE t; } cache[AN_C1_NCACHE];
+    static int ncache = 0, next = 0;
+    double *coef;
+    int    i;
+
+    for (i=0; i<ncache; i++)
+        if (cache[i].cf==cf && cache[i].tdres==tdres && cache[i].taumax==taumax && cache[i].taumin==taumin)
+        {
+            *t = cache[i].t;
+            t->coef = NULL;
+            if (t->n>0 && (t->coef = (double*)ANWorkAlloc(work,C1TableBytes(t))) != NULL)
+                memcpy(t->coef, cache[i].t.coef, C1TableBytes(t));
+            return;
+        }
+
+    C1TableSetup(t,cf,tdres,taumax,taumin);
+    if (t->n==0) return;
+    t->coef = (double*)ANWorkAlloc(work,C1TableBytes(t));
+    if (t->coef==NULL) return;
+    C1TableFit(t,t->n,t->coef);
+
+    if ((coef = (double*)malloc(C1TableBytes(t))) == NULL) return;   /* not kept */
+    memcpy(coef, t->coef, C1TableBytes(t));
+    if (ncache==AN_C1_NCACHE) free(cache[next].t.coef);
+    cache[next].cf = cf; cache[next].tdres = tdres; cache[next].taumax = taumax; cache[next].taumin = taumin;
+    cache[next].t = *t;
+    cache[next].t.coef = coef;
+    next = (next+1) % AN_C1_NCACHE;
+    if (ncache<AN_C1_NCACHE) ncache++;
+}
+
+/* The coefficients of the sections of C1 for the pole shift rsigma, from the table when it
+   covers rsigma */
+static int C1Sections(const C1TABLE *tab, double rsigma, double *sec)
+{
+    double u, t;
+    const double *cf;
+    int    j, k;
+
+    u = (log(tab->sigma0 + rsigma) - tab->lo)*tab->scale;
+    if (tab->coef!=NULL && u>=0 && u<=tab->n)
+    {
+        k  = __min((int)u, tab->n-1);
+        t  = u-k;
+        cf = tab->coef + 4*k*AN_C1_NCOEF;
+        for (j=0; j<AN_C1_NCOEF; j++)
+            sec[j] = cf[j] + t*(cf[AN_C1_NCOEF+j] + t*(cf[2*AN_C1_NCOEF+j] + t*cf[3*AN_C1_NCOEF+j]));
+        return(AN_OK);
+    }
+    return(ChirpSections(tab, -tab->sigma0 - rsigma, sec));
+}
+
+static double C1ChirpFilt(double x, long n, double rsigma, const C1TABLE *tab, CHIRPSTATE *c1)
+{
+    static const int sect[6] = {0, 0, 5, 10, 0, 10};   /* sections 1..5 are p1, p3, p5, p1, p5 */
+    double (*C1input)[4] = c1->input, (*C1output)[4] = c1->output;
+    double sec[AN_C1_NCOEF], dy;
+    const double *s;
+    int    i, err;
+
+   if (n==0)
+   {
+       c1->initphase = tab->initphase;
+       c1->gain_norm = tab->gain_norm;
+       memset(c1->input, 0, sizeof(c1->input));
+       memset(c1->output, 0, sizeof(c1->output));
+   };
+
+    /* the coefficients for the shift of the poles */
+    if ((err = C1Sections(tab, rsigma, sec)) != AN_OK) { c1->err = err; return(0.0); }
+
+   /*%==================================================  */
+    /*each loop below is for a pair of poles and one zero */
+   /*%      time loop begins here                         */
+   /*%==================================================  */
+
+       C1input[1][3]=C1input[1][2];
+       C1input[1][2]=C1input[1][1];
+       C1input[1][1]= x;
+
+       for (i=1;i<=5;i++)
+       {
+           s  = sec + sect[i];
+           dy = s[0]*C1input[i][1] + s[1]*C1input[i][2] + s[2]*C1input[i][3]
+                + s[3]*C1output[i][1] + s[4]*C1output[i][2];
+
+           C1input[i+1][3] = C1output[i][2];
+           C1input[i+1][2] = C1output[i][1];
+           C1input[i+1][1] = dy;
+
+           C1output[i][2] = C1output[i][1];
+           C1output[i][1] = dy;
+       }
+
+       dy = C1output[5][1]*tab->norm_gain;  /* don't forget the gain term */
+       return (dy/4.0);   /* signal path output is divided by 4 to give correct C1 filter gain */
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/** Parallelpath C2 filter: same as the signal-path C1 filter with the OHC completely impaired.
+    Its poles do not move, so it is a fixed cascade of the five sections (coefficients sec, set
+    up by IHCANInit), run section by section over a block of nsamp samples of x. */
+
+/* The five sections with fixed coefficients sec over a block (without the gain), with the
+   memories of c as C1ChirpFilt keeps them */
+static void ChirpCascade(const double *x, long nsamp, const double *sec, CHIRPSTATE *c, double *out)
+{
+    static const int sect[6] = {0, 0, 5, 10, 0, 10};   /* sections 1..5 are p1, p3, p5, p1, p5 */
+    double (*Cinput)[4] = c->input, (*Coutput)[4] = c->output;
+    double b0, b1, b2, a1, a2, x0, x1, x2, x3, y0, y1, y2;
+    const double *s, *in;
+    long   k;
+    int    i;
+
+    /* the memories of section i are its last three inputs and two outputs, as in C1 */
+    for (i=1, in=x; i<=5; i++, in=out)
+    {
+        s  = sec + sect[i];
+        b0 = s[0]; b1 = s[1]; b2 = s[2]; a1 = s[3]; a2 = s[4];
+        x1 = Cinput[i][1];  x2 = Cinput[i][2];  x3 = Cinput[i][3];
+        y1 = Coutput[i][1]; y2 = Coutput[i][2];
+        for (k=0; k<nsamp; k++)
+        {
+            x0 = in[k];
+            y0 = b0*x0 + b1*x1 + b2*x2 + a1*y1 + a2*y2;
+            x3 = x2; x2 = x1; x1 = x0;
+            y2 = y1; y1 = y0;
+            out[k] = y0;
+        }
+        Cinput[i][1] = x1;  Cinput[i][2] = x2;  Cinput[i][3] = x3;
+        Coutput[i][1] = y1; Coutput[i][2] = y2;
+    }
+}
+
+static void C2ChirpFilt(const double *x, long nsamp, const C1TABLE *tab, const double *sec, CHIRPSTATE *c2,
+                        double *c2filterout)
+{
+    double gain;
+    long   k;
+
+    ChirpCascade(x, nsamp, sec, c2, c2filterout);
+
+    gain = tab->norm_gain/4.0;   /* signal path output is divided by 4 to give correct filter gain */
+    for (k=0; k<nsamp; k++) c2filterout[k] *= gain;
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/** Pass the signal through the Control path Third Order Nonlinear Gammatone Filter */
+
+/* The filter memories start at zero (IHCSTATE is cleared by IHCANInit).  The frequency shift
+   rotates a phasor by the phase step on each sample; every WB_RENORM samples the phasor and the
+   step are recomputed from the phase, which is kept within [-pi,pi] so that it does not lose
+   precision on long stimuli. */
+static double WbGammaTone(double x,double tdres,double centerfreq, double tau,double gain, WBSTATE *wb)
+{
+  COMPLEX *wbgtf = wb->gtf, *wbgtfl = wb->gtfl, rot;
+
+  double delta_phase,dtmp,c1LP,c2LP,g,out;
+  int i,j;
+
+  delta_phase = -TWOPI*centerfreq*tdres;
+  wb->phase += delta_phase;
+  if (wb->phase < -TWOPI/2) wb->phase += TWOPI;
+  if (wb->phase >  TWOPI/2) wb->phase -= TWOPI;
+
+  if (wb->nrot==0)
+  {
+      wb->rot  = compexp(wb->phase);
+      wb->step = compexp(delta_phase);
+  }
+  else
+  {
+      CLET(rot, wb->rot);
+      CMULT(wb->rot, rot, wb->step);
+  }
+  wb->nrot = (wb->nrot+1) % WB_RENORM;
+
+  dtmp = tau*2.0/tdres;
+  c1LP = (dtmp-1)/(dtmp+1);
+  c2LP = 1.0/(dtmp+1);
+  CTREAL(wbgtf[0], wb->rot, x);                            /* FREQUENCY SHIFT */
+
+  g = c2LP*gain;
+  for(j = 1; j <= WB_ORDER; j++)                           /* IIR Bilinear transformation LPF */
+  {
+      wbgtf[j].x = g*(wbgtf[j-1].x+wbgtfl[j-1].x) + c1LP*wbgtfl[j].x;
+      wbgtf[j].y = g*(wbgtf[j-1].y+wbgtfl[j-1].y) + c1LP*wbgtfl[j].y;
+  }
+  out = CDRN(wbgtf[WB_ORDER], wb->rot);                    /* FREQ SHIFT BACK UP: real part of gtf*conj(rot) */
+
+  for(i=0; i<=WB_ORDER;i++) wbgtfl[i] = wbgtf[i];
+  return(out);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/** Calculate the gain and group delay for the Control path Filter */
+
+double gain_groupdelay(double tdres,double centerfreq, double cf, double tau,int *grdelay)
+{
+  double tmpcos,dtmp2,c1LP,c2LP,tmp1,tmp2,wb_gain;
+
+  tmpcos = cos(TWOPI*(centerfreq-cf)*tdres);
+  dtmp2 = tau*2.0/tdres;
+  c1LP = (dtmp2-1)/(dtmp2+1);
+  c2LP = 1.0/(dtmp2+1);
+  tmp1 = 1+c1LP*c1LP-2*c1LP*tmpcos;
+  tmp2 = 2*c2LP*c2LP*(1+tmpcos);
+
+  wb_gain = pow(tmp1/tmp2, 1.0/2.0);
+
+  grdelay[0] = (int)floor((0.5-(c1LP*c1LP-c1LP*tmpcos)/(1+c1LP*c1LP-2*c1LP*tmpcos)));
+
+  return(wb_gain);
+}
+/* -------------------------------------------------------------------------------------------- */
+/** Calculate the delay (basilar membrane, synapse, etc. for cat) */
+double delay_cat(double cf)
+{
+  double A0,A1,x,delay;
+
+  A0    = 3.0;
+  A1    = 12.5;
+  x     = 11.9 * log10(0.80 + cf / 456.0);      /* cat mapping */
+  delay = A0 * exp( -x/A1 ) * 1e-3;
+
+  return(delay);
+}
+
+/* Calculate the delay (basilar membrane, synapse, etc.) for human, based
+        on Harte et al. (JASA 2009) */
+double delay_human(double cf)
+{
+  double A,B,delay;
+
+  A    = -0.37;
+  B    = 11.09/2;
+  delay = B * pow(cf * 1e-3,A)*1e-3;
+
+  return(delay);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Get the output of the OHC Nonlinear Function (Boltzman Function) */
+
+double Boltzman(double x, double asym, double s0, double s1, double x1)
+  {
+    double shift,x0,out1,out;
+
+    shift = 1.0/(1.0+asym);  /* asym is the ratio of positive Max to negative Max*/
+    x0    = s0*log((1.0/shift-1)/(1+exp(x1/s1)));
+
+    out1 = 1.0/(1.0+exp(-(x-x0)/s0)*(1.0+exp(-(x-x1)/s1)))-shift;
+    out = out1/(1-shift);
+
+    return(out);
+  }  /* output of the nonlinear function, the output is normalized with maximum value of 1 */
+
+/* -------------------------------------------------------------------------------------------- */
+/* Coefficients of the first-order sections of a low-pass filter with cutoff Fc (bilinear transform);
+   the filter memories start at zero (IHCSTATE is cleared by IHCANInit) */
+
+static void LowPassInit(LPSTATE *lp, double tdres, double Fc)
+{
+  double c;
+
+  c = 2.0/tdres;
+  lp->c1LP = ( c - TWOPI*Fc ) / ( c + TWOPI*Fc );
+  lp->c2LP = TWOPI*Fc / (TWOPI*Fc + c);
+}
+/* -------------------------------------------------------------------------------------------- */
+/* Get the output of the OHC Low Pass Filter in the Control path */
+
+static double OhcLowPass(double x,double gain, LPSTATE *lp)
+{
+  double *ohc = lp->y, *ohcl = lp->yl;
+  double c1LP = lp->c1LP, c2LP = lp->c2LP;
+  int i,j;
+
+  ohc[0] = x*gain;
+  for(i=0; i<OHC_ORDER;i++)
+    ohc[i+1] = c1LP*ohcl[i+1] + c2LP*(ohc[i]+ohcl[i]);
+  for(j=0; j<=OHC_ORDER;j++) ohcl[j] = ohc[j];
+  return(ohc[OHC_ORDER]);
+}
+/* -------------------------------------------------------------------------------------------- */
+/* The middle-ear filter and the IHC low-pass filter are cascades of linear time-invariant
+   sections, run over a block with the sections skewed: section k filters sample m at step m+k,
+   so that on each step the sections only read what the section before them wrote on the
+   previous step and run side by side, rather than each waiting for the one before it on the
+   same sample.  Every sample still goes through the same operations in the same order as in
+   the per-sample filters, so the outputs are identical.  h0, h1 and h2 hold the last outputs
+   of each section (section 0 is the input), and the sections are updated in place from the
+   last one down.  While the skew fills and drains at the ends of a block only the sections
+   klo..khi that have a sample run; in between, all of them run with their state in locals. */
+
+/* Sample n = 0 or 1 of the middle-ear filter (three biquads), which start from simplified forms */
+static double MiddleEarStart(IHCSTATE *st, double x, long n, const int human)
+{
+    double *mey1 = st->mey1, *mey2 = st->mey2, *mey3 = st->mey3, y1, y2, y3;
+
+    if (n==0)  /* Start of the middle-ear filtering section  */
+    {
+        y1 = st->m11*x;
+        if (human) y1 = st->m11*st->m14*x;
+        y2 = y1*st->m24*st->m21;
+        y3 = y2*st->m34*st->m31;
+    }
+    else
+    {
+        y1 = st->m11*(-st->m12*mey1[0] + x     - st->px1);
+        if (human) y1 = st->m11*(-st->m12*mey1[0]+st->m14*x+st->m15*st->px1);
+        y2 = st->m21*(-st->m22*mey2[0] + st->m24*y1 + st->m25*mey1[0]);
+        y3 = st->m31*(-st->m32*mey3[0] + st->m34*y2 + st->m35*mey2[0]);
+    };
+    st->px2 = st->px1;  st->px1 = x;
+    mey1[1] = mey1[0];  mey1[0] = y1;
+    mey2[1] = mey2[0];  mey2[0] = y2;
+    mey3[1] = mey3[0];  mey3[0] = y3;
+    return(y3/st->megainmax);
+}
+
+/* Sections klo..khi of the middle ear, whose coefficients are m[6*(k-1)..6*(k-1)+5] */
+static void MiddleEarSteps(const double *m, double *h0, double *h1, double *h2, int klo, int khi)
+{
+    const double *c;
+    double y;
+    int    k;
+
+    for (k=khi; k>=klo; k--)
+    {
+        c = m+6*(k-1);
+        y = c[0]*(-c[1]*h0[k] - c[2]*h1[k] + c[3]*h0[k-1] + c[4]*h1[k-1] + c[5]*h2[k-1]);
+        h2[k] = h1[k]; h1[k] = h0[k]; h0[k] = y;
+    }
+}
+
+/* The middle-ear output of the next nb samples of px.  The cat's first section is the human
+   form with m13 = m16 = 0, m14 = 1 and m15 = -1 (as set by IHCANInit), which gives the same
+   sums. */
+static void MiddleEarBlock(IHCSTATE *st, const double *px, long nb, double *me, const int human)
+{
+    double m[18], h0[4], h1[4], h2[4], a[4], b[4], c[4];
+    long   i, t;
+    int    k;
+
+    for (i=0; i<nb && st->n+i<2; i++)
+        me[i] = MiddleEarStart(st, px[i], st->n+i, human);
+    if (i==nb) return;
+    px += i; me += i; nb -= i;
+
+    m[0]  = st->m11; m[1]  = st->m12; m[2]  = st->m13; m[3]  = st->m14; m[4]  = st->m15; m[5]  = st->m16;
+    m[6]  = st->m21; m[7]  = st->m22; m[8]  = st->m23; m[9]  = st->m24; m[10] = st->m25; m[11] = st->m26;
+    m[12] = st->m31; m[13] = st->m32; m[14] = st->m33; m[15] = st->m34; m[16] = st->m35; m[17] = st->m36;
+    h0[0] = st->px1;     h1[0] = st->px2;
+    h0[1] = st->mey1[0]; h1[1] = st->mey1[1];
+    h0[2] = st->mey2[0]; h1[2] = st->mey2[1];
+    h0[3] = st->mey3[0]; h1[3] = st->mey3[1];
+    h2[0] = h2[1] = h2[2] = h2[3] = 0;   /* not read before it is shifted in */
+
+    for (t=0; t<3; t++)
+    {
+        MiddleEarSteps(m, h0, h1, h2, (t-nb+1>1) ? (int)(t-nb+1) : 1, (int)t);
+        if (t<nb) { h2[0] = h1[0]; h1[0] = h0[0]; h0[0] = px[t]; }
+    }
+    for (k=0; k<4; k++) { a[k] = h0[k]; b[k] = h1[k]; c[k] = h2[k]; }
+    for (; t<nb; t++)
+    {
+        for (k=3; k>=1; k--)
+        {
+            double y = m[6*k-6]*(-m[6*k-5]*a[k] - m[6*k-4]*b[k] + m[6*k-3]*a[k-1] + m[6*k-2]*b[k-1] + m[6*k-1]*c[k-1]);
+            c[k] = b[k]; b[k] = a[k]; a[k] = y;
+        }
+        c[0] = b[0]; b[0] = a[0]; a[0] = px[t];
+        me[t-3] = a[3]/st->megainmax;
+    }
+    for (k=0; k<4; k++) { h0[k] = a[k]; h1[k] = b[k]; h2[k] = c[k]; }
+    for (; t<nb+3; t++)
+    {
+        MiddleEarSteps(m, h0, h1, h2, (t-nb+1>1) ? (int)(t-nb+1) : 1, 3);
+        if (t<nb) { h2[0] = h1[0]; h1[0] = h0[0]; h0[0] = px[t]; }
+        me[t-3] = h0[3]/st->megainmax;
+    }
+
+    st->px1     = h0[0]; st->px2     = h1[0];
+    st->mey1[0] = h0[1]; st->mey1[1] = h1[1];
+    st->mey2[0] = h0[2]; st->mey2[1] = h1[2];
+    st->mey3[0] = h0[3]; st->mey3[1] = h1[3];
+}
+
+/* Sections klo..khi of the IHC low-pass filter */
+static void IhcLowPassSteps(double c1LP, double c2LP, double *h0, double *h1, int klo, int khi)
+{
+    double u;
+    int    k;
+
+    for (k=khi; k>=klo; k--)
+    {
+        u = h0[k];
+        h0[k] = c1LP*u + c2LP*(h0[k-1]+h1[k-1]);
+        h1[k] = u;
+    }
+}
+
+/* The IHC low-pass filter over the next nb samples of x (out may be x) */
+static void IhcLowPassBlock(LPSTATE *lp, const double *x, long nb, double *out)
+{
+    double c1LP = lp->c1LP, c2LP = lp->c2LP, u;
+    double h0[IHC_ORDER+1], h1[IHC_ORDER+1], a[IHC_ORDER+1], b[IHC_ORDER+1];
+    long   t;
+    int    k;
+
+    for (k=0; k<=IHC_ORDER; k++) { h0[k] = lp->yl[k]; h1[k] = 0; }
+
+    for (t=0; t<IHC_ORDER; t++)
+    {
+        IhcLowPassSteps(c1LP, c2LP, h0, h1, (t-nb+1>1) ? (int)(t-nb+1) : 1, (int)t);
+        if (t<nb) { h1[0] = h0[0]; h0[0] = x[t]; }
+    }
+    for (k=0; k<=IHC_ORDER; k++) { a[k] = h0[k]; b[k] = h1[k]; }
+    for (; t<nb; t++)
+    {
+        for (k=IHC_ORDER; k>=1; k--)
+        {
+            u = a[k];
+            a[k] = c1LP*u + c2LP*(a[k-1]+b[k-1]);
+            b[k] = u;
+        }
+        b[0] = a[0]; a[0] = x[t];
+        out[t-IHC_ORDER] = a[IHC_ORDER];
+    }
+    for (k=0; k<=IHC_ORDER; k++) { h0[k] = a[k]; h1[k] = b[k]; }
+    for (; t<nb+IHC_ORDER; t++)
+    {
+        IhcLowPassSteps(c1LP, c2LP, h0, h1, (t-nb+1>1) ? (int)(t-nb+1) : 1, IHC_ORDER);
+        if (t<nb) { h1[0] = h0[0]; h0[0] = x[t]; }
+        out[t-IHC_ORDER] = h0[IHC_ORDER];
+    }
+
+    for (k=0; k<=IHC_ORDER; k++) lp->y[k] = lp->yl[k] = h0[k];
+}
+/* -------------------------------------------------------------------------------------------- */
+/* Get the output of the Control path using Nonlinear Function after OHC */
+
+double NLafterohc(double x,double taumin, double taumax, double asym)
+{
+    double R,dc,R1,s0,x1,out,minR;
+
+    minR = 0.05;
+    R  = taumin/taumax;
+
+    if(R<minR) minR = 0.5*R;
+    else       minR = minR;
+
+    dc = (asym-1)/(asym+1.0)/2.0-minR;
+    R1 = R-minR;
+
+    /* This is for new nonlinearity */
+    s0 = -dc/log(R1/(1-minR));
+
+    x1  = fabs(x);
+    out = taumax*(minR+(1.0-minR)*exp(-x1/s0));
+    if (out<taumin) out = taumin;
+    if (out>taumax) out = taumax;
+    return(out);
+}
+/* -------------------------------------------------------------------------------------------- */
+/* Get the output of the IHC Nonlinear Function (Logarithmic Transduction Functions) */
+
+double NLogarithm(double x, double slope, double asym, double cf)
+{
+    double corner,strength,xx,splx,asym_t;
+
+    corner    = 80;
+    strength  = 20.0e6/pow(10,corner/20);
+
+    xx = log(1.0+strength*fabs(x))*slope;
+
+    if(x<0)
+    {
+        splx   = 20*log10(-x/20e-6);
+        asym_t = asym -(asym-1)/(1+exp(splx/5.0));
+        xx = -1/asym_t*xx;
+    };
+    return(xx);
+}
+/* -------------------------------------------------------------------------------------------- */
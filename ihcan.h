@@ -0,0 +1,140 @@
+#ifndef _IHCAN_H
+#define _IHCAN_H
+
+/* IHCAN.H header file
+ * middle ear, control path, signal path (C1 and C2 filters) and inner hair cell (IHC) sections
+ * of the model.  All the filter memories live in an IHCSTATE, so that a stimulus can be
+ * processed in consecutive segments and the state saved and restored between them.
+*/
+
+#include "complex.hpp"
+#include "anmodel.h"
+
+/* State of a signal-path chirp filter (C1 or C2) */
+typedef struct __CHIRPSTATE
+{
+    double gain_norm, initphase;
+    double input[12][4], output[12][4];
+    int    err;
+} CHIRPSTATE;
+
+/* Coefficients of C1 as a function of the pole shift rsigma = 1/tauc1-1/bmTaumax, where the
+   control path keeps tauc1 between bmTaumin and bmTaumax: the normalised biquad coefficients
+   {b0,b1,b2,a1,a2} of the three distinct sections (pole pairs p1, p3 and p5) are cubics of
+   log(1/tauc1) on each of n intervals, fitted so that no coefficient is off by more than
+   AN_C1_TOL of the largest of its kind.  If that takes more than AN_C1_MAXTAB intervals, n is
+   0 and the coefficients are computed on each sample. */
+#define AN_C1_NCOEF  15
+#define AN_C1_MAXTAB 512
+#define AN_C1_TOL    1e-10
+#define AN_C1_NCACHE 8      /* tables kept by IHCANInit for fibers of the same CF */
+
+typedef struct __C1TABLE
+{
+    double sigma0, ipw, ipb, rpa, CF, fsb, rzero0, initphase, gain_norm, norm_gain;   /* constants of C1 */
+    double lo, hi, scale;   /* range of log(1/tauc1), intervals per unit of it */
+    int    n;
+    double *coef;           /* the cubic of interval k is sum of coef[(4*k+d)*AN_C1_NCOEF+j]*t^d, t in [0,1] */
+} C1TABLE;
+
+/* State of the control-path wideband gammatone filter */
+typedef struct __WBSTATE
+{
+    double  phase;              /* phase of the frequency shift, within [-pi,pi] */
+    COMPLEX rot, step;          /* exp(i*phase) and the rotation per sample */
+    int     nrot;               /* samples since rot was last computed from phase */
+    COMPLEX gtf[4], gtfl[4];
+} WBSTATE;
+
+/* State of the OHC and IHC low-pass filters (cascades of up to 7 first-order sections) */
+typedef struct __LPSTATE
+{
+    double c1LP, c2LP;      /* coefficients of the sections, fixed by IHCANInit */
+    double y[8], yl[8];
+} LPSTATE;
+
+/* Silence: input with |px| <= silence (0 by default: exact zeros) is fast-forwarded once the
+   filters have decayed to within quiettol (AN_IHC_QUIETTOL by default, 0 to disable) of rest.
+   The control part then only advances the gain schedule and the phase of the control-path
+   filter, and if nothing reaches the signal path, C1 and the IHC are skipped and the output is
+   zero.  The filters are checked every IHC_BLOCK samples of the stimulus, counted from its
+   start whatever the calls, and each part fast-forwards from there for as long as its input
+   stays silent (quietctl and quietsig, kept from one call to the next), so a stimulus run in
+   segments gives the same output as in one call.  silence and quiettol can be changed after
+   IHCANInit; skipctl and skipsig count the samples fast-forwarded by each part. */
+#define AN_IHC_QUIETTOL 1e-12
+
+typedef struct __IHCSTATE
+{
+    /* model parameters */
+    double cf, tdres, cohc, cihc;
+    int    species;
+
+    /* constants derived from the parameters */
+    double centerfreq, TauWBMax, TauWBMin, bmTaumax, bmTaumin, ratiobm;
+    double megainmax, m11,m12,m13,m14,m15,m16,m21,m22,m23,m24,m25,m26,m31,m32,m33,m34,m35,m36;
+    int    delaypoint;  /* total path delay (in samples) of the IHC output */
+    int    ngain;       /* length of the tmpgain ring, longer than the largest control-path group delay */
+    int    delayed;     /* 1 if IHCANRun applies the path delay itself */
+
+    /* running state */
+    long   n;                               /* index of the next input sample */
+    double px1, px2;                        /* previous two input samples */
+    double mey1[2], mey2[2], mey3[2];       /* previous two outputs of each middle-ear section */
+    double tauwb, wbgain, lasttmpgain;
+    WBSTATE    wb;
+    LPSTATE    ohc, ihc;
+    CHIRPSTATE c1, c2;
+    int    dpos;                            /* position in the delay line */
+    C1TABLE    c1tab;                       /* coefficients of C1, fixed by IHCANInit */
+    double     c2sec[AN_C1_NCOEF];          /* coefficients of the sections of C2, fixed by IHCANInit */
+    int        c1fixed;                     /* cohc is 0: C1 has the fixed pole shift c1rsigma and coefficients
+                                               c1sec, and the control path is not run */
+    double     c1rsigma, c1sec[AN_C1_NCOEF];
+
+    /* fast-forward through silence (see above) */
+    double silence, quiettol, ohcrest;
+    int    quietctl, quietsig;              /* the control and signal parts are fast-forwarding */
+    long   skipctl, skipsig;                /* samples fast-forwarded by the control and signal parts */
+
+    /* buffers */
+    double *tmpgain;    /* gains of the control-path filter scheduled by its group delay (ngain) */
+    double *delayline;  /* IHC output waiting for the path delay (delaypoint), if delayed */
+    ANWORK *work;       /* workspace of the buffers (NULL for the heap) */
+} IHCSTATE;
+
+/* Set up a fiber.  If delayed is nonzero the output of IHCANRun is delayed by st->delaypoint
+   samples (zeros first); otherwise the caller applies the delay.  The buffers are taken from
+   work, which must have IHCANWorkSize bytes free (or NULL for the heap). */
+int  IHCANInit(IHCSTATE *st, double cf, double tdres, double cohc, double cihc, int species, int delayed,
+               ANWORK *work);
+size_t IHCANWorkSize(double cf, double tdres, int species, int delayed);
+/* Run the next nsamp samples of the stimulus px (in Pa) and write the IHC output */
+int  IHCANRun(IHCSTATE *st, const double *px, long nsamp, double *ihcout);
+/* The two halves of IHCANRun, which can run concurrently on copies of the state (as in a
+   pipeline): the middle ear, the control path and the (linear) C2 filter write the middle-ear
+   output, the pole shift of C1 and the C2 output of each sample to ctl[3*i], ctl[3*i+1] and
+   ctl[3*i+2], from which C1, the IHC and the path delay go on.  Each copy advances st->n
+   itself. */
+int  IHCANRunControl(IHCSTATE *st, const double *px, long nsamp, double *ctl);
+int  IHCANRunSignal(IHCSTATE *st, const double *ctl, long nsamp, double *ihcout);
+/* Sweeps of cihc, which only scales the C1 output ahead of the IHC transduction: IHCANRunPre
+   runs everything upstream of it and writes the C1 output (before cihc) and the C2
+   transduction output of each sample to pre[2*i] and pre[2*i+1], from which IHCANRunPost goes
+   on with st->cihc.  One fiber runs IHCANRunPre, and one fiber per value of cihc (set up by
+   IHCANInit with the same other parameters) runs IHCANRunPost on its output.  Each advances
+   st->n itself.  The output is that of IHCANRun, except that C1 may be fast-forwarded through
+   silence before the IHC low-pass has decayed (a difference within st->quiettol). */
+int  IHCANRunPre(IHCSTATE *st, const double *px, long nsamp, double *pre);
+int  IHCANRunPost(IHCSTATE *st, const double *pre, long nsamp, double *ihcout);
+void IHCANFree(IHCSTATE *st);
+
+/* Checkpoint support: append the complete state to a blob / restore it into a fiber
+   that was set up by IHCANInit with the same parameters */
+void IHCANSaveState(const IHCSTATE *st, ANBLOB *blob);
+int  IHCANLoadState(IHCSTATE *st, ANBLOB *blob);
+
+double delay_cat(double cf);
+double delay_human(double cf);
+
+#endif
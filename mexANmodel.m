@@ -1,4 +1,8 @@
 clear all;
-mex -v model_IHC.c complex.c
+mex -v model_IHC.c ihcan.c anmodel.c complex.c
 clear all;
-mex -v model_Synapse.c complex.c
+mex -v model_Synapse.c synapse.c spkstats.c powerlaw.c resample.c ffgn.c anmodel.c complex.c
+clear all;
+mex -v model_SynapseBank.c synapse.c spkstats.c powerlaw.c resample.c ffgn.c anmodel.c complex.c
+clear all;
+mex -v model_Batch.c ihcan.c synapse.c spkstats.c powerlaw.c resample.c ffgn.c anmodel.c complex.c
@@ -0,0 +1,30 @@
+#ifndef _MEXSEED_H
+#define _MEXSEED_H
+
+/* MEXSEED.H header file
+ * the seed of the native random-number generators of the MEX functions, included by each of
+ * them after mex.h (static, as every MEX file is built on its own)
+*/
+
+#include <stdint.h>
+
+/* Seed drawn from MATLAB's rand, so that rng() still controls the fGn and the spike times */
+static uint64_t DrawSeed(void)
+{
+    mxArray  *randInputArray[1], *randOutputArray[1];
+    double   *randNums, *randDims;
+    uint64_t seed;
+
+    randInputArray[0] = mxCreateDoubleMatrix(1, 2, mxREAL);
+    randDims = mxGetPr(randInputArray[0]);
+    randDims[0] = 1;
+    randDims[1] = 2;
+    mexCallMATLAB(1, randOutputArray, 1, randInputArray, "rand");
+    randNums = mxGetPr(randOutputArray[0]);
+    seed = ((uint64_t)(randNums[0]*4294967296.0) << 32) ^ (uint64_t)(randNums[1]*4294967296.0);
+
+    mxDestroyArray(randInputArray[0]); mxDestroyArray(randOutputArray[0]);
+    return(seed);
+}
+
+#endif
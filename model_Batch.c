@@ -0,0 +1,197 @@
+/* This is Version 5.2 of the code for auditory periphery model of:
+
+    Zilany, M.S.A., Bruce, I.C., Nelson, P.C., and Carney, L.H. (2009). "A Phenomenological
+        model of the synapse between the inner hair cell and auditory nerve : Long-term adaptation
+        with power-law dynamics," Journal of the Acoustical Society of America 126(5): 2390-2412.
+
+   with the modifications and simulation options described in:
+
+    Zilany, M.S.A., Bruce, I.C., Ibrahim, R.A., and Carney, L.H. (2013). "Improved parameters
+        and expanded simulation options for a model of the auditory periphery,"
+        in Abstracts of the 36th ARO Midwinter Research Meeting.
+
+   Humanization in this version includes:
+   - Human middle-ear filter, based on the linear middle-ear circuit model of Pascal et al. (JASA 1998)
+   - Human BM tuning, based on Shera et al. (PNAS 2002) or Glasberg & Moore (Hear. Res. 1990)
+   - Human frequency-offset of control-path filter (i.e., cochlear amplifier mechanism), based on Greenwood (JASA 1990)
+
+   The modifications to the BM tuning are described in:
+
+        Ibrahim, R. A., and Bruce, I. C. (2010). "Effects of peripheral tuning on the auditory nerve's representation
+            of speech envelope and temporal fine structure cues," in The Neurophysiological Bases of Auditory Perception,
+            eds. E. A. Lopez-Poveda and A. R. Palmer and R. Meddis, Springer, NY, pp. 429438.
+
+   Please cite these papers if you publish any research
+   results obtained with this code or any modified versions of this code.
+
+   See the file readme.txt for details of compiling and running the model.
+
+   %%%  M. S. Arefeen Zilany (msazilany@gmail.com), Ian C. Bruce (ibruce@ieee.org),
+         Rasha A. Ibrahim, Paul C. Nelson, and Laurel H. Carney - November 2013 %%%
+
+*/
+
+#include <stdint.h>
+typedef uint16_t char16_t;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>      /* Added for MS Visual C++ compatability, by Ian Bruce, 1999 */
+#include <mex.h>
+#include <time.h>
+/* #include <iostream.h> */
+
+#include "complex.hpp"
+#include "anmodel.h"
+#include "ihcan.h"
+#include "synapse.h"
+#include "mexseed.h"
+
+/* Workspace of the model buffers, kept from one call to the next (see model_Synapse.c) */
+static ANWORK work;
+static void FreeWork(void) { ANWorkFree(&work); }
+
+/* model_Batch runs many (short) stimuli of any lengths through one fiber, as model_IHC followed
+   by model_Synapse would with nrep = 1 and reptime the duration of each stimulus:
+
+       [meanrate,varrate,psth] = model_Batch(stims,CF,tdres,cohc,cihc,species,fiberType,noiseType,implnt);
+
+   stims is a cell array of row vectors (in Pa).  The outputs are packed back to back in one row:
+   with off = [0 cumsum(cellfun(@numel,stims))], the response to stims{s} is
+   meanrate(off(s)+1:off(s+1)).  The arguments are checked, the workspace is sized for the
+   longest stimulus and the seeds are drawn from MATLAB once per call, and the tables of C1 and
+   the filters of the resamplers are kept from one stimulus to the next (ihcan.c, resample.c),
+   so that a stimulus costs little more than running it.  Each stimulus has its own fGn and
+   spikes, and only the requested outputs are computed. */
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    double cf, tdres, cohc, cihc, fibertype, noiseType, implnt, spont;
+    int    nstim, species, s, err;
+    long   len, maxlen, total, off, nspmax, nspikes, nout, t;
+    uint64_t seed;
+    size_t bytes, mark;
+
+    double *px, *meanrate, *varrate, *psth, *ihcout, *synout, *sptime;
+    long   *spindex;
+    const mxArray *stim;
+
+    IHCSTATE ihc;
+    SYNSTATE syn;
+    SPKSTATE sg;
+
+    if (nrhs != 9)
+        mexErrMsgTxt("model_Batch requires 9 input arguments.");
+    if ((nlhs<1) || (nlhs>3))
+        mexErrMsgTxt("model_Batch requires 1 to 3 output arguments.");
+
+    mexAtExit(FreeWork);
+    ANWorkReset(&work,0);
+
+    if (!mxIsCell(prhs[0]) || mxGetNumberOfElements(prhs[0])<1)
+        mexErrMsgTxt("stims must be a cell array of stimuli.\n");
+    nstim = (int)mxGetNumberOfElements(prhs[0]);
+    for (s=0, maxlen=0, total=0; s<nstim; s++)
+    {
+        stim = mxGetCell(prhs[0], s);
+        if (stim==NULL || !mxIsDouble(stim) || mxIsComplex(stim) || mxGetM(stim)!=1 || mxGetN(stim)<1)
+            mexErrMsgTxt("Each stimulus must be a real row vector.\n");
+        len    = (long)mxGetN(stim);
+        maxlen = __max(maxlen, len);
+        total += len;
+    }
+
+    cf        = mxGetScalar(prhs[1]);
+    tdres     = mxGetScalar(prhs[2]);
+    cohc      = mxGetScalar(prhs[3]);
+    cihc      = mxGetScalar(prhs[4]);
+    species   = (int)mxGetScalar(prhs[5]);
+    fibertype = mxGetScalar(prhs[6]);
+    noiseType = mxGetScalar(prhs[7]);
+    implnt    = mxGetScalar(prhs[8]);
+
+    if ((mxGetScalar(prhs[5])!=species) || (species<1) || (species>3))
+        mexErrMsgTxt("Species must be 1 for cat, or 2 or 3 for human.\n");
+    if ((cf<124.9) || (cf>((species==1) ? 40.1e3 : 20.1e3)))
+    {
+        mexPrintf("cf (= %1.1f Hz) must be between 125 Hz and %s kHz for the %s model\n",
+                  cf, (species==1) ? "40" : "20", (species==1) ? "cat" : "human");
+        mexErrMsgTxt("\n");
+    }
+    if ((cohc<0) || (cohc>1) || (cihc<0) || (cihc>1))
+        mexErrMsgTxt("cohc and cihc must be between 0 and 1.\n");
+    if ((fibertype!=1) && (fibertype!=2) && (fibertype!=3))
+        mexErrMsgTxt("fiberType must be 1, 2 or 3.\n");
+    spont = (fibertype==1) ? 0.1 : (fibertype==2) ? 4.0 : 100.0;
+
+    plhs[0] = mxCreateDoubleMatrix(1, total, mxREAL);
+    if (nlhs>1) plhs[1] = mxCreateDoubleMatrix(1, total, mxREAL);
+    if (nlhs>2) plhs[2] = mxCreateDoubleMatrix(1, total, mxREAL);
+    meanrate = mxGetPr(plhs[0]);
+    varrate  = (nlhs>1) ? mxGetPr(plhs[1]) : NULL;
+    psth     = (nlhs>2) ? mxGetPr(plhs[2]) : NULL;
+
+    mexPrintf("ANmodel: Zilany, Bruce, Ibrahim, and Carney : Auditory Nerve Model\n");
+
+    /* one workspace for the longest stimulus, reused by every stimulus (the spike generator is
+       set up here for its sizes only) */
+    SpikeGeneratorInit(&sg, tdres, maxlen, 0, &work);
+    nspmax = SpikeGeneratorMaxSpikes(&sg, maxlen);
+    bytes  = IHCANWorkSize(cf,tdres,species,1) + SynapseWorkSize(cf,tdres,implnt,0,maxlen)
+             + 2*ANWorkRound(maxlen*sizeof(double));
+    if (psth!=NULL)
+        bytes += ANWorkRound(nspmax*sizeof(double)) + ANWorkRound(nspmax*sizeof(long)) + SpikeGeneratorWorkSize(maxlen);
+    err = ANWorkReserve(&work, bytes);
+    if (err!=AN_OK)
+        mexErrMsgTxt(ANErrorMessage(err));
+
+    ihcout = (double*)ANWorkAlloc(&work, maxlen*sizeof(double));
+    synout = (double*)ANWorkAlloc(&work, maxlen*sizeof(double));
+    mark   = ANWorkMark(&work);
+
+    /* stimulus s is seeded as fiber s of a population (population.c) */
+    seed = DrawSeed();
+    for (s=0, off=0; (s<nstim) && (err==AN_OK); s++, off+=len)
+    {
+        stim = mxGetCell(prhs[0], s);
+        px   = mxGetPr(stim);
+        len  = (long)mxGetN(stim);
+
+        /*====== IHC, with the path delay applied (zeros first) ======*/
+        err = IHCANInit(&ihc, cf, tdres, cohc, cihc, species, 1, &work);
+        if (err==AN_OK)
+            err = IHCANRun(&ihc, px, len, ihcout);
+        IHCANFree(&ihc);
+        ANWorkReset(&work, mark);
+        if (err!=AN_OK) break;
+
+        /*====== Synapse, and the refractory effects (Vannucci and Teich, 1978) ======*/
+        err = SynapseInit(&syn, cf, tdres, spont, noiseType, implnt, 0, len, seed + 2*(uint64_t)s, &work);
+        if (err!=AN_OK) break;
+        nout = SynapseRun(&syn, ihcout, len, synout);
+        SynapseFree(&syn);
+        ANWorkReset(&work, mark);
+        for (t=0; t<nout; t++)
+        {
+            if (varrate!=NULL)
+                varrate[off+t] = synout[t]/pow((1+0.75e-3*synout[t]),3);
+            meanrate[off+t] = synout[t]/(1+0.75e-3*synout[t]);
+        }
+
+        /*======  Spike Generations ======*/
+        if (psth!=NULL)
+        {
+            SpikeGeneratorInit(&sg, tdres, len, seed + 2*(uint64_t)s + 1, &work);
+            sptime  = (double*)ANWorkAlloc(&work, nspmax*sizeof(double));
+            spindex = (long*)ANWorkAlloc(&work, nspmax*sizeof(long));
+            nspikes = SpikeGeneratorRunEvents(&sg, synout, nout, sptime, spindex);
+            for (t=0; t<nspikes; t++)
+                psth[off+spindex[t]] += 1;
+            ANWorkReset(&work, mark);
+        }
+    }
+
+    ANWorkReset(&work,0);
+    if (err!=AN_OK)
+        mexErrMsgTxt(ANErrorMessage(err));
+}
@@ -0,0 +1,178 @@
+/* This is Version 5.2 of the code for auditory periphery model of:
+
+    Zilany, M.S.A., Bruce, I.C., Nelson, P.C., and Carney, L.H. (2009). "A Phenomenological
+        model of the synapse between the inner hair cell and auditory nerve : Long-term adaptation
+        with power-law dynamics," Journal of the Acoustical Society of America 126(5): 2390-2412.
+
+   with the modifications and simulation options described in:
+
+    Zilany, M.S.A., Bruce, I.C., Ibrahim, R.A., and Carney, L.H. (2013). "Improved parameters
+        and expanded simulation options for a model of the auditory periphery,"
+        in Abstracts of the 36th ARO Midwinter Research Meeting.
+
+   Humanization in this version includes:
+   - Human middle-ear filter, based on the linear middle-ear circuit model of Pascal et al. (JASA 1998)
+   - Human BM tuning, based on Shera et al. (PNAS 2002) or Glasberg & Moore (Hear. Res. 1990)
+   - Human frequency-offset of control-path filter (i.e., cochlear amplifier mechanism), based on Greenwood (JASA 1990)
+
+   The modifications to the BM tuning are described in:
+
+        Ibrahim, R. A., and Bruce, I. C. (2010). "Effects of peripheral tuning on the auditory nerve's representation
+            of speech envelope and temporal fine structure cues," in The Neurophysiological Bases of Auditory Perception,
+            eds. E. A. Lopez-Poveda and A. R. Palmer and R. Meddis, Springer, NY, pp. 429438.
+
+   Please cite these papers if you publish any research
+   results obtained with this code or any modified versions of this code.
+
+   See the file readme.txt for details of compiling and running the model.
+
+   %%%  M. S. Arefeen Zilany (msazilany@gmail.com), Ian C. Bruce (ibruce@ieee.org),
+         Rasha A. Ibrahim, Paul C. Nelson, and Laurel H. Carney - November 2013 %%%
+
+*/
+
+#include <stdint.h>
+typedef uint16_t char16_t;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>      /* Added for MS Visual C++ compatability, by Ian Bruce, 1999 */
+#include <mex.h>
+#include <time.h>
+/* #include <iostream.h> */
+
+#include "anmodel.h"
+#include "synapse.h"
+#include "mexseed.h"
+
+/* Workspace of the model buffers, kept from one call to the next (see model_Synapse.c) */
+static ANWORK work;
+static void FreeWork(void) { ANWorkFree(&work); }
+
+/* model_SynapseBank runs many fibers of one CF on the same IHC output:
+
+       [meanrate,varrate,psth] = model_SynapseBank(vihc,CF,nrep,tdres,spont,noiseType,implnt);
+
+   spont is a vector of spontaneous rates (in spikes/s, any positive values), one per fiber,
+   and row i of the outputs is the response of fiber i.  The arguments are otherwise those of
+   model_Synapse, and only the requested outputs are computed. */
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    double cf, tdres, noiseType, implnt, *spont;
+    int    nrep, nfib, pxbins, totalstim, ipst, i, err;
+    long   nsamp, nspmax, nspikes, t;
+    size_t bytes, mark;
+
+    double *px, *meanrate, *varrate, *psth, *synbuf, **synout, *sptime;
+    long   *spindex;
+
+    SYNBANK  bank;
+    SPKSTATE sg;
+
+    if (nrhs != 7)
+        mexErrMsgTxt("model_SynapseBank requires 7 input arguments.");
+    if ((nlhs<1) || (nlhs>3))
+        mexErrMsgTxt("model_SynapseBank requires 1 to 3 output arguments.");
+
+    mexAtExit(FreeWork);
+    ANWorkReset(&work,0);
+
+    px        = mxGetPr(prhs[0]);
+    pxbins    = mxGetN(prhs[0]);
+    if (pxbins==1)
+        mexErrMsgTxt("px must be a row vector\n");
+    cf        = mxGetScalar(prhs[1]);
+    if (!((cf>=80) && (cf<=40e3)))
+    {
+        mexPrintf("cf (= %1.1f Hz) must be between 80 Hz and 40 kHz\n",cf);
+        mexErrMsgTxt("\n");
+    }
+    nrep      = (int)mxGetScalar(prhs[2]);
+    if ((mxGetScalar(prhs[2])!=nrep) || (nrep<1))
+        mexErrMsgTxt("nrep must be a positive integer.\n");
+    tdres     = mxGetScalar(prhs[3]);
+    if (!(tdres>0))
+        mexErrMsgTxt("tdres must be positive.\n");
+    spont     = mxGetPr(prhs[4]);
+    nfib      = (int)mxGetNumberOfElements(prhs[4]);
+    if (nfib<1)
+        mexErrMsgTxt("spont must list the spontaneous rate of at least one fiber.\n");
+    for (i=0; i<nfib; i++)
+        if (!(spont[i]>0))
+            mexErrMsgTxt("The spontaneous rates must be positive.\n");
+    noiseType = mxGetScalar(prhs[5]);
+    implnt    = mxGetScalar(prhs[6]);
+
+    totalstim = (int)floor(pxbins/nrep);
+    nsamp     = (long)totalstim*nrep;
+
+    plhs[0] = mxCreateDoubleMatrix(nfib, totalstim, mxREAL);
+    if (nlhs>1) plhs[1] = mxCreateDoubleMatrix(nfib, totalstim, mxREAL);
+    if (nlhs>2) plhs[2] = mxCreateDoubleMatrix(nfib, totalstim, mxREAL);
+    meanrate = mxGetPr(plhs[0]);
+    varrate  = (nlhs>1) ? mxGetPr(plhs[1]) : NULL;
+    psth     = (nlhs>2) ? mxGetPr(plhs[2]) : NULL;
+
+    mexPrintf("ANmodel: Zilany, Bruce, Ibrahim, and Carney : Auditory Nerve Model\n");
+
+    /* the synapse outputs of all the fibers, then the spike times of one fiber at a time */
+    SpikeGeneratorInit(&sg, tdres, nsamp, 0, &work);
+    nspmax = SpikeGeneratorMaxSpikes(&sg, nsamp);
+    bytes  = SynapseBankWorkSize(cf,tdres,nfib,implnt,0,nsamp) + ANWorkRound(nfib*nsamp*sizeof(double))
+             + ANWorkRound(nfib*sizeof(double*));
+    if (psth!=NULL)
+        bytes += ANWorkRound(nspmax*sizeof(double)) + ANWorkRound(nspmax*sizeof(long)) + SpikeGeneratorWorkSize(nsamp);
+    err = ANWorkReserve(&work, bytes);
+    if (err!=AN_OK)
+        mexErrMsgTxt(ANErrorMessage(err));
+
+    synbuf = (double*)ANWorkAlloc(&work, nfib*nsamp*sizeof(double));
+    synout = (double**)ANWorkAlloc(&work, nfib*sizeof(double*));
+    for (i=0; i<nfib; i++)
+        synout[i] = synbuf+i*nsamp;
+
+    /*====== Run the synapses, all on one pass over vihc ======*/
+    err = SynapseBankInit(&bank, cf, tdres, spont, nfib, noiseType, implnt, 0, nsamp, DrawSeed(), &work);
+    if (err!=AN_OK)
+    {
+        ANWorkReset(&work,0);
+        mexErrMsgTxt(ANErrorMessage(err));
+    }
+    SynapseBankRun(&bank, px, nsamp, synout);
+    SynapseBankFree(&bank);
+
+    /* Wrapping up the repetitions, and the refractory effects (Vannucci and Teich, 1978) */
+    for (i=0; i<nfib; i++)
+    {
+        for (t=0; t<nsamp; t++)
+            meanrate[i+nfib*(t%totalstim)] += synout[i][t]/nrep;
+        for (t=0; t<totalstim; t++)
+        {
+            if (varrate!=NULL)
+                varrate[i+nfib*t] = meanrate[i+nfib*t]/pow((1+0.75e-3*meanrate[i+nfib*t]),3);
+            meanrate[i+nfib*t] = meanrate[i+nfib*t]/(1+0.75e-3*meanrate[i+nfib*t]);
+        }
+    }
+
+    /*======  Spike Generations ======*/
+    if (psth!=NULL)
+    {
+        mark = ANWorkMark(&work);
+        for (i=0; i<nfib; i++)
+        {
+            SpikeGeneratorInit(&sg, tdres, nsamp, DrawSeed(), &work);
+            sptime  = (double*)ANWorkAlloc(&work,nspmax*sizeof(double));
+            spindex = (long*)ANWorkAlloc(&work,nspmax*sizeof(long));
+            nspikes = SpikeGeneratorRunEvents(&sg, synout[i], nsamp, sptime, spindex);
+            for (t=0; t<nspikes; t++)
+            {
+                ipst = (int) (fmod(sptime[t],tdres*totalstim) / tdres);
+                psth[i+nfib*ipst] += 1;
+            }
+            ANWorkReset(&work, mark);
+        }
+    }
+
+    ANWorkReset(&work,0);
+}
@@ -0,0 +1,184 @@
+/*
+pipeline.c runs the IHC sections of a fiber in two processes of their own, so that the
+control path, the signal path and the synapse of one fiber work concurrently
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "anmodel.h"
+#include "ihcan.h"
+#include "population.h"
+#include "pipeline.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define AN_PIPE_POLL 1024   /* spins between checks that the other stages are alive */
+
+int ANPipeCreate(ANPIPE *p)
+{
+    unsigned char *base;
+
+    memset(p, 0, sizeof(ANPIPE));
+    p->size = 2*sizeof(ANRING) + 64;
+    base = (unsigned char*)mmap(NULL, p->size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (base==(unsigned char*)MAP_FAILED) { p->size = 0; return(AN_ENOMEM); }
+    p->base    = base;
+    p->abort   = (volatile int*)base;
+    p->ring[0] = (ANRING*)(base+64);
+    p->ring[1] = (ANRING*)(base+64+sizeof(ANRING));
+    return(AN_OK);
+}
+
+size_t ANPipeBytes(double cf, double tdres, int species)
+{
+    return(2*sizeof(ANRING) + 64
+           + 2*(sizeof(IHCSTATE) + IHCANWorkSize(cf, tdres, species, 1) + 4*AN_PIPE_BLOCK*sizeof(double)));
+}
+
+void ANPipeFree(ANPIPE *p)
+{
+    if (p->base!=NULL) munmap(p->base, p->size);
+    p->base = NULL;
+}
+
+/* Called while a ring is full or empty; returns nonzero if the pipeline has to stop.  The
+   stages stop when they are aborted or orphaned, and the owner when a stage has died. */
+static int PipeWait(ANPIPE *p, long *spins)
+{
+    int k, status;
+
+    sched_yield();
+    if (++*spins % AN_PIPE_POLL) return(0);
+    if (*p->abort) return(1);
+    if (getpid()!=p->owner) return(getppid()!=p->owner);
+    for (k=0; k<2; k++)
+        if (p->pid[k]>0 && waitpid(p->pid[k], &status, WNOHANG)==p->pid[k])
+        {
+            p->pid[k]    = 0;
+            p->status[k] = status;
+            if (!WIFEXITED(status) || WEXITSTATUS(status)!=0) return(1);
+        }
+    return(0);
+}
+
+static int RingPut(ANPIPE *p, ANRING *r, const double *x, long n)
+{
+    long i, spins = 0;
+
+    while (r->head+n-r->tail > AN_PIPE_CAP)
+        if (PipeWait(p, &spins)) return(AN_EWORKER);
+    for (i=0; i<n; i++) r->data[(r->head+i) & (AN_PIPE_CAP-1)] = x[i];
+    __sync_synchronize();   /* the data are written before they are published */
+    r->head += n;
+    return(AN_OK);
+}
+
+static int RingGet(ANPIPE *p, ANRING *r, double *x, long n)
+{
+    long i, spins = 0;
+
+    while (r->tail+n > r->head)
+    {
+        if (r->err!=AN_OK) return(r->err);
+        if (PipeWait(p, &spins)) return(AN_EWORKER);
+    }
+    __sync_synchronize();
+    for (i=0; i<n; i++) x[i] = r->data[(r->tail+i) & (AN_PIPE_CAP-1)];
+    __sync_synchronize();   /* the data are read before the space is given back */
+    r->tail += n;
+    return(AN_OK);
+}
+
+/* Stage 0: middle ear, control path and C2 */
+static void PipeControl(ANPIPE *p, IHCSTATE *st, const ANSIGNAL *px, long nsamp)
+{
+    double x[AN_PIPE_BLOCK], ctl[3*AN_PIPE_BLOCK];
+    long   t, n, i;
+    int    err = AN_OK;
+
+    for (t=0; t<nsamp && err==AN_OK; t+=n)
+    {
+        n = __min(AN_PIPE_BLOCK, nsamp-t);
+        for (i=0; i<n; i++)
+            x[i] = (px->fmt==AN_FLOAT32) ? ((const float*)px->data)[t+i] : ((const double*)px->data)[t+i];
+        if ((err = IHCANRunControl(st, x, n, ctl)) == AN_OK)
+            err = RingPut(p, p->ring[0], ctl, 3*n);
+    }
+    p->ring[0]->err = err;
+    _exit(0);
+}
+
+/* Stage 1: C1, IHC and path delay */
+static void PipeSignal(ANPIPE *p, IHCSTATE *st, long nsamp)
+{
+    double ctl[3*AN_PIPE_BLOCK], y[AN_PIPE_BLOCK];
+    long   t, n;
+    int    err = AN_OK;
+
+    for (t=0; t<nsamp && err==AN_OK; t+=n)
+    {
+        n = __min(AN_PIPE_BLOCK, nsamp-t);
+        if ((err = RingGet(p, p->ring[0], ctl, 3*n)) == AN_OK
+            && (err = IHCANRunSignal(st, ctl, n, y)) == AN_OK)
+            err = RingPut(p, p->ring[1], y, n);
+    }
+    p->ring[1]->err = err;
+    _exit(0);
+}
+
+int ANPipeStart(ANPIPE *p, const IHCSTATE *st, const ANSIGNAL *px, long nsamp)
+{
+    IHCSTATE copy = *st;   /* each stage works on its own copy (the buffers are copied by fork) */
+    int      k;
+
+    *p->abort = 0;
+    for (k=0; k<2; k++)
+    {
+        p->ring[k]->head = 0; p->ring[k]->tail = 0; p->ring[k]->err = AN_OK;
+        p->status[k] = 0;
+    }
+    __sync_synchronize();
+    p->owner = getpid();
+
+    fflush(NULL);
+    if ((p->pid[0] = fork()) == 0) PipeControl(p, &copy, px, nsamp);
+    if (p->pid[0]>0 && (p->pid[1] = fork()) == 0) PipeSignal(p, &copy, nsamp);
+    if (p->pid[0]<0 || p->pid[1]<0) return(ANPipeFinish(p, AN_EWORKER));
+    return(AN_OK);
+}
+
+int ANPipeGet(ANPIPE *p, double *ihcout, long n)
+{
+    long t, m;
+    int  err;
+
+    for (t=0; t<n; t+=m)
+    {
+        m = __min(AN_PIPE_BLOCK, n-t);
+        if ((err = RingGet(p, p->ring[1], ihcout+t, m)) != AN_OK) return(err);
+    }
+    return(AN_OK);
+}
+
+int ANPipeFinish(ANPIPE *p, int err)
+{
+    int k;
+
+    if (err!=AN_OK) *p->abort = 1;
+    for (k=0; k<2; k++)
+    {
+        if (p->pid[k]>0 && waitpid(p->pid[k], &p->status[k], 0)!=p->pid[k]) p->status[k] = -1;
+        if (p->pid[k]>0 && (!WIFEXITED(p->status[k]) || WEXITSTATUS(p->status[k])!=0) && err==AN_OK)
+            err = AN_EWORKER;
+        p->pid[k] = 0;
+    }
+    return(err);
+}
@@ -0,0 +1,58 @@
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+
+/* PIPELINE.H header file
+ * runs the sections of one fiber as a pipeline of processes (POSIX only), for populations with
+ * fewer fibers than CPUs: the middle ear, control path and C2 filter, the C1 filter and IHC,
+ * and the synapse (in the calling process) each get a CPU.  The middle-ear output, the pole
+ * shift of C1 and the C2 output are the only signals from the first stage to the second, and
+ * the IHC output the only one to the synapse, so the stages are joined by single-producer/
+ * single-consumer rings in a shared mapping, which are passed without locks.
+*/
+
+#include <sys/types.h>
+#include "anmodel.h"
+#include "ihcan.h"
+#include "population.h"
+
+#define AN_PIPE_CAP   65536   /* doubles in each ring (a power of 2) */
+#define AN_PIPE_BLOCK 512     /* samples passed at a time */
+
+typedef struct __ANRING
+{
+    volatile long head;         /* doubles written (only by the producer) */
+    char   pad1[64-sizeof(long)];
+    volatile long tail;         /* doubles read (only by the consumer) */
+    char   pad2[64-sizeof(long)];
+    volatile int  err;          /* error of the producer, which then stops */
+    char   pad3[64-sizeof(int)];
+    double data[AN_PIPE_CAP];
+} ANRING;
+
+typedef struct __ANPIPE
+{
+    ANRING *ring[2];            /* control path -> signal path, IHC -> synapse */
+    volatile int *abort;        /* set to stop all the stages */
+    pid_t   owner;              /* the process that consumes the IHC output */
+    pid_t   pid[2];             /* the stage processes while they run */
+    int     status[2];
+    void   *base;
+    size_t  size;
+} ANPIPE;
+
+/* The rings are mapped once and reused by all the fibers of a process */
+int  ANPipeCreate(ANPIPE *p);
+/* Memory of a pipe running a fiber of characteristic frequency cf: the rings, and the copies of
+   the IHC state and its buffers and the block buffers of the two stages */
+size_t ANPipeBytes(double cf, double tdres, int species);
+void ANPipeFree(ANPIPE *p);
+/* Start the control-path and signal-path stages on copies of st (just set up by IHCANInit,
+   with delayed output) for nsamp samples of px */
+int  ANPipeStart(ANPIPE *p, const IHCSTATE *st, const ANSIGNAL *px, long nsamp);
+/* The next n samples of the IHC output */
+int  ANPipeGet(ANPIPE *p, double *ihcout, long n);
+/* Reap the stages (stopping them first if err is not AN_OK); returns err, or AN_EWORKER if
+   a stage died */
+int  ANPipeFinish(ANPIPE *p, int err);
+
+#endif
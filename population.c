@@ -0,0 +1,320 @@
+/*
+population.c runs the work items of a model population: the IHC and synapse stages of one
+fiber are streamed through in chunks of AN_POP_CHUNK samples, so the memory needed for an
+item does not grow with the length of the stimulus
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "anmodel.h"
+#include "ihcan.h"
+#include "synapse.h"
+#include "population.h"
+#include "pipeline.h"
+
+int ANPopNumItems(const ANPOPSPEC *spec)
+{
+    return(spec->ncf*spec->ntypes);
+}
+
+double ANPopSpont(int fibertype)
+{
+    /* Spontaneous Rate of the fiber corresponding to Fibertype */
+    if (fibertype==1) return(0.1);
+    if (fibertype==2) return(4.0);
+    return(100.0);
+}
+
+double ANPopSynRate(const ANPOPSPEC *spec, double cf)
+{
+    /* the power-law section runs on the output of a decimator, so 8 samples per period of
+       the CF keep the phase locking of low-CF fibers; 10 kHz is the standard rate */
+    if (spec->synrate==AN_SYNRATE_AUTO) return(__min(10e3, __max(2e3, 8*cf)));
+    return((spec->synrate>0) ? spec->synrate : 10e3);
+}
+
+int ANPopCheck(const ANPOPSPEC *spec)
+{
+    int i;
+
+    /* the tests are written so that a NaN fails them */
+    if (!(spec->tdres>0) || spec->ncf<1 || spec->ntypes<1 || spec->ntypes>3) return(AN_EPARAM);
+    if (!(spec->cohc>=0 && spec->cohc<=1) || !(spec->cihc>=0 && spec->cihc<=1)) return(AN_EPARAM);
+    if ((spec->noiseType!=0 && spec->noiseType!=1) || (spec->implnt!=0 && spec->implnt!=1)) return(AN_EPARAM);
+    if (!(spec->silence>=0 && spec->silence<HUGE_VAL)) return(AN_EPARAM);
+    if (spec->species<1 || spec->species>3) return(AN_EPARAM);
+    /* exactly one AN_PROD_ bit (ANPopProduct knows no combinations) */
+    if (spec->product<=0 || (spec->product & (spec->product-1))!=0 || ANPopStages(spec->product)==0)
+        return(AN_EPARAM);
+    if (!(spec->synrate>=0) && spec->synrate!=AN_SYNRATE_AUTO) return(AN_EPARAM);
+    if (ReducerCheck(spec->red, spec->nred)!=AN_OK) return(AN_EPARAM);
+    if (spec->product==AN_PROD_STATS && (spec->nred>0 || SpikeStatsCheck(&spec->stats)!=AN_OK)) return(AN_EPARAM);
+    for (i=0; i<spec->ncf; i++)
+        if (!(spec->cf[i]>=124.9 && spec->cf[i]<=((spec->species==1) ? 40.1e3 : 20.1e3))) return(AN_EPARAM);
+    for (i=0; i<spec->ntypes; i++)
+        if (spec->fibertype[i]<1 || spec->fibertype[i]>3) return(AN_EPARAM);
+    return(AN_OK);
+}
+
+long ANPopOutLength(const ANPOPSPEC *spec, long nsamp)
+{
+    if (spec->product==AN_PROD_STATS) return(SpikeStatsLength(&spec->stats));
+    return(ReducerLength(spec->red, spec->nred, nsamp));
+}
+
+int ANPopStages(int products)
+{
+    int stages = 0;
+
+    if (products & (AN_PROD_IHC|AN_PROD_SYNOUT|AN_PROD_MEANRATE|AN_PROD_VARRATE|AN_PROD_PSTH|AN_PROD_STATS))
+        stages |= AN_STAGE_IHC;
+    if (products & (AN_PROD_SYNOUT|AN_PROD_MEANRATE|AN_PROD_VARRATE|AN_PROD_PSTH|AN_PROD_STATS))
+        stages |= AN_STAGE_SYNAPSE;
+    if (products & (AN_PROD_PSTH|AN_PROD_STATS))
+        stages |= AN_STAGE_SPIKES;
+    return(stages);
+}
+
+/* Sizes of the buffers of an item: the stimulus chunk (single-precision input only), the IHC
+   output, and the synapse output and spike times of a chunk, which can include the output
+   that lags behind the previous chunk */
+static long PopSynBuf(const ANPOPSPEC *spec, double cf)
+{
+    return(AN_POP_CHUNK + SynapseMaxLag(spec->tdres, ANPopSynRate(spec, cf)));
+}
+
+long ANPopMaxSpikes(const ANPOPSPEC *spec, long n)
+{
+    return(n/((long)floor(0.00075/spec->tdres)+1)+1);   /* as SpikeGeneratorMaxSpikes */
+}
+
+static size_t PopWorkSize(const ANPOPSPEC *spec, int item, long nsamp, int fmt, int stages)
+{
+    double cf = spec->cf[item/spec->ntypes];
+    long   nbuf = PopSynBuf(spec, cf);
+    size_t bytes = 0;
+
+    if (stages & AN_STAGE_IHC)
+        bytes += IHCANWorkSize(cf, spec->tdres, spec->species, 1) + ANWorkRound(AN_POP_CHUNK*sizeof(double))
+                 + ((fmt==AN_FLOAT32) ? ANWorkRound(AN_POP_CHUNK*sizeof(double)) : 0);
+    if (stages & AN_STAGE_SYNAPSE)
+        bytes += SynapseWorkSize(cf, spec->tdres, spec->implnt, ANPopSynRate(spec, cf), nsamp)
+                 + ANWorkRound(nbuf*sizeof(double));
+    if ((stages & AN_STAGE_SPIKES) && spec->product!=AN_PROD_STATS)
+        bytes += ANWorkRound(ANPopMaxSpikes(spec, nbuf)*sizeof(double)) + ANWorkRound(ANPopMaxSpikes(spec, nbuf)*sizeof(long));
+    if (stages & AN_STAGE_SPIKES)
+        bytes += SpikeGeneratorWorkSize(nbuf);
+    if ((stages & AN_STAGE_SPIKES) && spec->product==AN_PROD_STATS)
+        bytes += SpikeStatsWorkSize(&spec->stats) + ANWorkRound(SpikeStatsLength(&spec->stats)*sizeof(double));
+    return(bytes + ReducerWorkSize(spec->red, spec->nred));
+}
+
+size_t ANPopWorkSize(const ANPOPSPEC *spec, int item, long nsamp, int fmt)
+{
+    return(PopWorkSize(spec, item, nsamp, fmt, ANPopStages(spec->product)));
+}
+
+size_t ANPopMaxWorkSize(const ANPOPSPEC *spec, long nsamp, int fmt)
+{
+    size_t bytes, max = 0;
+    int    item;
+
+    for (item=0; item<ANPopNumItems(spec); item++)
+        if ((bytes = ANPopWorkSize(spec, item, nsamp, fmt)) > max) max = bytes;
+    return(max);
+}
+
+/* The states of the stages, which ANPopRunItem keeps on the stack */
+static size_t PopStateBytes(const ANPOPSPEC *spec, int stages)
+{
+    size_t bytes = 0;
+
+    if (stages & AN_STAGE_IHC)     bytes += sizeof(IHCSTATE);
+    if (stages & AN_STAGE_SYNAPSE) bytes += sizeof(SYNSTATE);
+    if (stages & AN_STAGE_SPIKES)  bytes += sizeof(SPKSTATE);
+    if (spec->nred>0)              bytes += sizeof(REDUCER);
+    if ((stages & AN_STAGE_SPIKES) && spec->product==AN_PROD_STATS) bytes += sizeof(SPKSTATS);
+    return(bytes);
+}
+
+size_t ANPopItemBytes(const ANPOPSPEC *spec, long nsamp, int stages)
+{
+    return(PopWorkSize(spec, 0, nsamp, AN_FLOAT64, stages) + PopStateBytes(spec, stages));
+}
+
+size_t ANPopPeakBytes(const ANPOPSPEC *spec, long nsamp, int fmt, int pipeline)
+{
+    size_t bytes, pipe = 0;
+    int    icf;
+
+    bytes = ANPopMaxWorkSize(spec, nsamp, fmt) + PopStateBytes(spec, ANPopStages(spec->product));
+    if (pipeline)
+        for (icf=0; icf<spec->ncf; icf++)
+            pipe = __max(pipe, ANPipeBytes(spec->cf[icf], spec->tdres, spec->species));
+    return(bytes + pipe);
+}
+
+size_t ANSignalSize(int fmt)
+{
+    return((fmt==AN_FLOAT32) ? sizeof(float) : sizeof(double));
+}
+
+/* Write n samples of a product, held in double precision in x, to the output row (of rowlen samples) */
+static void PutRow(ANSIGNAL *out, long item, long rowlen, long pos, const double *x, long n)
+{
+    double *row  = (double*)out->data + (size_t)item*rowlen + pos;
+    float  *rowf = (float*)out->data + (size_t)item*rowlen + pos;
+    long    i;
+
+    if (out->fmt==AN_FLOAT32)
+        for (i=0; i<n; i++) rowf[i] = (float)x[i];
+    else if (row!=x)
+        for (i=0; i<n; i++) row[i] = x[i];
+}
+
+void ANPopProduct(int product, SPKSTATE *sg, double *x, long n, long pos, double *sptime, long *spindex)
+{
+    long i, nspk;
+
+    /* Synapse Output taking into account the Refractory Effects (Vannucci and Teich, 1978) */
+    switch (product)
+    {
+        case AN_PROD_MEANRATE:
+            for (i=0; i<n; i++) x[i] = x[i]/(1+0.75e-3*x[i]);
+            break;
+        case AN_PROD_VARRATE:
+            for (i=0; i<n; i++) x[i] = x[i]/pow((1+0.75e-3*x[i]),3);
+            break;
+        case AN_PROD_PSTH:
+            nspk = SpikeGeneratorRunEvents(sg, x, n, sptime, spindex);
+            for (i=0; i<n; i++) x[i] = 0;
+            for (i=0; i<nspk; i++) x[spindex[i]-pos] += 1;
+            break;
+        case AN_PROD_STATS:
+            SpikeGeneratorRunEvents(sg, x, n, NULL, NULL);
+            break;
+    }
+}
+
+int ANPopRunItem(const ANPOPSPEC *spec, int item, const ANSIGNAL *px, long nsamp, ANSIGNAL *out, ANWORK *work,
+                 ANPIPE *pipe, long *skipped)
+{
+    double   cf, *pxbuf, *ihcout, *synout, *dst, *sptime, *row;
+    long     n, nin, nout, nsyn, nbuf, i, *spindex, rowlen, nrow, nput;
+    int      err, stages, direct, dostats;
+    size_t   mark;
+
+    IHCSTATE st;
+    SYNSTATE syn;
+    SPKSTATE sg;
+    SPKSTATS stats;
+    REDUCER  red;
+
+    stages = ANPopStages(spec->product);
+    cf     = spec->cf[item/spec->ntypes];
+    mark   = ANWorkMark(work);
+    rowlen = ANPopOutLength(spec, nsamp);
+    dostats = (spec->product==AN_PROD_STATS);   /* the spikes are counted in the statistics, not stored */
+    direct  = (out->fmt==AN_FLOAT64 && spec->nred==0 && !dostats);   /* the product can be written straight into its row */
+
+    /* pxbuf is only needed for single-precision input, and synout when the synapse output
+       cannot be written straight into a double-precision row */
+    nbuf    = PopSynBuf(spec, cf);
+    pxbuf   = (px->fmt==AN_FLOAT32) ? (double*)ANWorkAlloc(work, AN_POP_CHUNK*sizeof(double)) : NULL;
+    ihcout  = (double*)ANWorkAlloc(work, AN_POP_CHUNK*sizeof(double));
+    synout  = (stages & AN_STAGE_SYNAPSE) ? (double*)ANWorkAlloc(work, nbuf*sizeof(double)) : NULL;
+    sptime  = ((stages & AN_STAGE_SPIKES) && !dostats) ? (double*)ANWorkAlloc(work, ANPopMaxSpikes(spec, nbuf)*sizeof(double)) : NULL;
+    spindex = ((stages & AN_STAGE_SPIKES) && !dostats) ? (long*)ANWorkAlloc(work, ANPopMaxSpikes(spec, nbuf)*sizeof(long)) : NULL;
+    row     = dostats ? (double*)ANWorkAlloc(work, rowlen*sizeof(double)) : NULL;
+    err     = AN_OK;
+    if (ihcout==NULL || (px->fmt==AN_FLOAT32 && pxbuf==NULL) || ((stages & AN_STAGE_SYNAPSE) && synout==NULL)
+        || ((stages & AN_STAGE_SPIKES) && !dostats && (sptime==NULL || spindex==NULL)) || (dostats && row==NULL))
+        err = AN_ENOMEM;
+    memset(&stats, 0, sizeof(SPKSTATS));
+    if (err==AN_OK && dostats)
+        err = SpikeStatsInit(&stats, &spec->stats, work);
+
+    if (skipped!=NULL) *skipped = 0;
+    if (err==AN_OK)
+        err = IHCANInit(&st, cf, spec->tdres, spec->cohc, spec->cihc, spec->species, 1, work);
+    if (err!=AN_OK)
+    {
+        SpikeStatsFree(&stats);
+        ANWorkRelease(work, pxbuf); ANWorkRelease(work, ihcout); ANWorkRelease(work, synout);
+        ANWorkRelease(work, sptime); ANWorkRelease(work, spindex); ANWorkRelease(work, row);
+        ANWorkReset(work, mark);
+        return(err);
+    }
+    st.silence = spec->silence;
+    if (stages & AN_STAGE_SYNAPSE)
+    {
+        err = SynapseInit(&syn, cf, spec->tdres, ANPopSpont(spec->fibertype[item%spec->ntypes]),
+                          spec->noiseType, spec->implnt, ANPopSynRate(spec, cf), nsamp, spec->seed + 2*(uint64_t)item, work);
+        if (err!=AN_OK) stages &= ~AN_STAGE_SYNAPSE;   /* nothing to free */
+    }
+    if (stages & AN_STAGE_SPIKES)
+    {
+        SpikeGeneratorInit(&sg, spec->tdres, nsamp, spec->seed + 2*(uint64_t)item + 1, work);
+        if (dostats) sg.stats = &stats;
+    }
+    memset(&red, 0, sizeof(REDUCER));
+    if (err==AN_OK)
+        err = ReducerInit(&red, spec->red, spec->nred, work);
+    if (err!=AN_OK || pipe==NULL)
+        pipe = NULL;
+    else if ((err = ANPipeStart(pipe, &st, px, nsamp)) != AN_OK)
+        pipe = NULL;   /* the stages were reaped by ANPipeStart */
+
+    nout = 0; nrow = 0;
+    for (nin=0; (nin<nsamp) && (err==AN_OK); nin+=n)
+    {
+        n = __min(AN_POP_CHUNK, nsamp-nin);
+        if (px->fmt==AN_FLOAT32 && pipe==NULL)
+            for (i=0; i<n; i++) pxbuf[i] = ((const float*)px->data)[nin+i];
+
+        /* the IHC potential can go straight into a double-precision row */
+        dst = (spec->product==AN_PROD_IHC && direct) ? (double*)out->data + (size_t)item*nsamp + nin : ihcout;
+        if (pipe!=NULL)
+            err = ANPipeGet(pipe, dst, n);
+        else
+            err = IHCANRun(&st, (px->fmt==AN_FLOAT32) ? pxbuf : (const double*)px->data+nin, n, dst);
+        if (err!=AN_OK) break;
+        if (!(stages & AN_STAGE_SYNAPSE))
+        {
+            nput  = ReducerRun(&red, dst, n, dst);
+            PutRow(out, item, rowlen, nrow, dst, nput);
+            nrow += nput;
+            continue;
+        }
+
+        /* the synapse output lags its input but never overtakes it, so it can be written into the
+           row; a chunk never returns more than nbuf samples */
+        if (SynapseMaxOutput(&syn, n)>nbuf) { err = AN_ENOMEM; break; }
+        dst  = direct ? (double*)out->data + (size_t)item*nsamp + nout : synout;
+        nsyn = SynapseRun(&syn, ihcout, n, dst);
+
+        ANPopProduct(spec->product, &sg, dst, nsyn, nout, sptime, spindex);
+        nout += nsyn;
+        if (dostats) continue;
+        nput  = ReducerRun(&red, dst, nsyn, dst);
+        PutRow(out, item, rowlen, nrow, dst, nput);
+        nrow += nput;
+    }
+    if (pipe!=NULL) err = ANPipeFinish(pipe, err);
+    if (err==AN_OK && dostats)
+    {
+        SpikeStatsClose(&stats, nsamp*spec->tdres);
+        SpikeStatsWrite(&stats, row);
+        PutRow(out, item, rowlen, 0, row, rowlen);
+    }
+    SpikeStatsFree(&stats);
+    ReducerFree(&red);
+    if (stages & AN_STAGE_SYNAPSE) SynapseFree(&syn);
+    if (skipped!=NULL) *skipped = st.skipctl;   /* the copy of a pipe does not run */
+    IHCANFree(&st);
+    ANWorkRelease(work, pxbuf); ANWorkRelease(work, ihcout); ANWorkRelease(work, synout);
+    ANWorkRelease(work, sptime); ANWorkRelease(work, spindex); ANWorkRelease(work, row);
+    ANWorkReset(work, mark);
+    return(err);
+}
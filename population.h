@@ -0,0 +1,103 @@
+#ifndef _POPULATION_H
+#define _POPULATION_H
+
+/* POPULATION.H header file
+ * a population of model fibers driven by one stimulus: one work item per (CF, fiber type),
+ * each producing a row of the CF x time neurogram.  Used by the native population runner.
+*/
+
+#include "anmodel.h"
+#include "reduce.h"
+#include "synapse.h"
+#include "spkstats.h"
+
+#define AN_POP_CHUNK 4096   /* samples processed per step through the IHC and synapse stages */
+
+/* Sample formats of the stimulus and output arrays (which may be memory-mapped files) */
+#define AN_FLOAT64   0
+#define AN_FLOAT32   1
+
+typedef struct __ANSIGNAL
+{
+    void *data;
+    int   fmt;
+} ANSIGNAL;
+
+size_t ANSignalSize(int fmt);
+
+/* Products that can be requested from a population; only the stages they need are run */
+#define AN_PROD_IHC       1   /* IHC potential (V) */
+#define AN_PROD_SYNOUT    2   /* synapse output rate (before refractoriness) */
+#define AN_PROD_MEANRATE  4   /* estimated instantaneous mean rate (incl. refractoriness) */
+#define AN_PROD_VARRATE   8   /* estimated instantaneous variance of the rate */
+#define AN_PROD_PSTH     16   /* spike counts per sample */
+#define AN_PROD_STATS    32   /* spike-train statistics of the whole run (SpikeStatsWrite), no spike times */
+
+#define AN_STAGE_IHC      1
+#define AN_STAGE_SYNAPSE  2   /* includes the fGn */
+#define AN_STAGE_SPIKES   4
+
+typedef struct __ANPOPSPEC
+{
+    double tdres, cohc, cihc, noiseType, implnt;
+    int    species;
+    uint64_t seed;          /* base seed; each item derives its own, so results do not depend on the schedule */
+    int    ncf;
+    double *cf;             /* characteristic frequencies (Hz) */
+    int    ntypes;
+    int    fibertype[3];    /* 1 (low), 2 (medium) or 3 (high spont) */
+    int    product;         /* one AN_PROD_ value: the quantity written to the output rows */
+    double synrate;         /* rate of the power-law section: 0 for 10 kHz, AN_SYNRATE_AUTO to
+                               lower it for low CFs, or a rate in Hz */
+    int    nred;            /* reductions applied to the product before it is written (0 for none) */
+    ANREDSTAGE red[AN_RED_MAXSTAGE];
+    SPKSTATSPEC stats;      /* statistics written for AN_PROD_STATS (which cannot be reduced) */
+    double silence;         /* stimulus samples within this of zero are silence (IHCSTATE, ihcan.h) */
+} ANPOPSPEC;
+
+#define AN_SYNRATE_AUTO  -1
+
+/* Items are ordered CF-major: item = icf*ntypes + itype */
+int    ANPopNumItems(const ANPOPSPEC *spec);
+int    ANPopCheck(const ANPOPSPEC *spec);
+double ANPopSpont(int fibertype);
+/* Rate asked of the power-law section of the fibers of characteristic frequency cf */
+double ANPopSynRate(const ANPOPSPEC *spec, double cf);
+
+/* Samples in an output row for a stimulus of nsamp samples, after the reductions (or the
+   length of the statistics) */
+long   ANPopOutLength(const ANPOPSPEC *spec, long nsamp);
+
+/* Stages needed for a set of products */
+int    ANPopStages(int products);
+/* Memory needed for one item of nsamp samples by the given stages (of the first CF) */
+size_t ANPopItemBytes(const ANPOPSPEC *spec, long nsamp, int stages);
+/* Workspace taken by ANPopRunItem for item, with stimulus format fmt; ANPopMaxWorkSize is the
+   largest over all the items, so a workspace of that size serves them all */
+size_t ANPopWorkSize(const ANPOPSPEC *spec, int item, long nsamp, int fmt);
+size_t ANPopMaxWorkSize(const ANPOPSPEC *spec, long nsamp, int fmt);
+/* Peak memory of a process that runs the items one after the other: ANPopMaxWorkSize, the
+   states of the stages and, with pipeline, the largest pipe (ANPipeBytes).  Apart from the
+   fGn and, for the actual implementation, the history of the power-law section, nothing
+   grows with nsamp: the stimulus is run in chunks of AN_POP_CHUNK samples. */
+size_t ANPopPeakBytes(const ANPOPSPEC *spec, long nsamp, int fmt, int pipeline);
+
+/* Turn n samples of the synapse output of a fiber, starting at its sample pos, into product in
+   place (for AN_PROD_PSTH by running the spike generator sg, with room for ANPopMaxSpikes(n)
+   spikes in sptime and spindex); the synapse output and the IHC potential are left as they are,
+   and for AN_PROD_STATS the spike generator only updates sg->stats */
+void   ANPopProduct(int product, SPKSTATE *sg, double *x, long n, long pos, double *sptime, long *spindex);
+long   ANPopMaxSpikes(const ANPOPSPEC *spec, long n);
+
+/* Run item of the population on the stimulus px (in Pa) and write spec->product for the
+   fiber, reduced by spec->red, to row item of out, an array of rows of ANPopOutLength samples.  Both are read and written
+   in place.  Stages that the product does not need are not set up at all.  The buffers are
+   taken from work (NULL for the heap), which is left as it was found.  With a pipe (see
+   pipeline.h) the IHC sections run in processes of their own.  If skipped is not NULL, it is
+   set to the number of samples that the control path fast-forwarded through silence (0 with
+   a pipe, whose stages do not report it). */
+struct __ANPIPE;
+int    ANPopRunItem(const ANPOPSPEC *spec, int item, const ANSIGNAL *px, long nsamp, ANSIGNAL *out, ANWORK *work,
+                    struct __ANPIPE *pipe, long *skipped);
+
+#endif
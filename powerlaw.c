@@ -0,0 +1,141 @@
+/*
+powerlaw.c fits banks of one-pole IIR sections to the power-law kernels of the synapse model,
+so that the approximate implementation can run at any sampling rate (the coefficients
+hard-coded in synapse.c were obtained for 10 kHz only)
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "anmodel.h"
+#include "powerlaw.h"
+
+#define AN_PL_NFIT    400   /* points at which the least-squares fit is made */
+#define AN_PL_NCHECK 1600   /* points at which the error is checked */
+#define AN_PL_NCACHE    8   /* fits kept by PowerLawCached */
+
+/* Sample points: every sample up to 16, then log-spaced up to the horizon */
+static double PowerLawPoint(long horizon, int m, int npts)
+{
+    if (m<16 || horizon<=16) return((double)__min(m, horizon-1));
+    return(floor(16*pow((horizon-1)/16.0, (double)(m-15)/(npts-16))));
+}
+
+/* Least-squares gains for poles exp(-u[i]), with the residuals weighted by 1/h(n) so that the
+   relative error is minimised (Householder QR); returns the maximum relative error */
+static double PowerLawSolve(double b, long horizon, int order, const double *u, double *gain)
+{
+    double a[AN_PL_NFIT*AN_PL_MAXORDER], r[AN_PL_NFIT];
+    double n, norm, s, alpha, err, maxerr;
+    int    i, j, m, M = AN_PL_NFIT;
+
+    for (m=0; m<M; m++)
+    {
+        n = PowerLawPoint(horizon, m, M);
+        for (i=0; i<order; i++) a[i*M+m] = exp(-u[i]*n)*(n+b);
+        r[m] = 1.0;
+    }
+    for (j=0; j<order; j++)
+    {
+        for (norm=0, m=j; m<M; m++) norm += a[j*M+m]*a[j*M+m];
+        norm = sqrt(norm);
+        if (norm==0) return(HUGE_VAL);
+        alpha = (a[j*M+j]>0) ? -norm : norm;
+        a[j*M+j] -= alpha;  /* a[j][j..M-1] is now the Householder vector v, with |v|^2 = 2*norm*(norm+|ajj|) */
+        s = norm*(norm+fabs(a[j*M+j]+alpha));
+        for (i=j+1; i<=order; i++)
+        {
+            double *col = (i<order) ? a+i*M : r, dot = 0;
+            for (m=j; m<M; m++) dot += a[j*M+m]*col[m];
+            dot /= s;
+            for (m=j; m<M; m++) col[m] -= dot*a[j*M+m];
+        }
+        a[j*M+j] = alpha;   /* diagonal of R */
+    }
+    for (j=order-1; j>=0; j--)
+    {
+        s = r[j];
+        for (i=j+1; i<order; i++) s -= a[i*M+j]*gain[i];
+        if (fabs(a[j*M+j]) < 1e-14*fabs(a[0])) return(HUGE_VAL);   /* rank deficient */
+        gain[j] = s/a[j*M+j];
+    }
+
+    for (maxerr=0, m=0; m<AN_PL_NCHECK; m++)
+    {
+        n = PowerLawPoint(horizon, m, AN_PL_NCHECK);
+        for (s=0, i=0; i<order; i++) s += gain[i]*exp(-u[i]*n);
+        err = fabs(s*(n+b)-1);
+        if (err>maxerr) maxerr = err;
+    }
+    return(maxerr);
+}
+
+int PowerLawFit(PLFILTER *f, double beta, double rate, long horizon, double tol)
+{
+    static const double clo[3] = {0.05, 0.2, 1.0}, chi[3] = {1.0, 4.0, 16.0};
+    double b, ulo, uhi, err, u[AN_PL_MAXORDER], g[AN_PL_MAXORDER], ubest[AN_PL_MAXORDER];
+    int    order, i, ilo, ihi;
+
+    memset(f, 0, sizeof(PLFILTER));
+    if (beta<=0 || rate<=0 || horizon<1 || tol<=0) return(AN_EPARAM);
+    f->rate = rate; f->beta = beta; f->horizon = horizon; f->tol = tol;
+    f->maxerr = HUGE_VAL;
+
+    /* h(n) = 1/(n+b) = integral of exp(-u*(n+b)) du, so the time constants needed lie between
+       about 1/u = b and the horizon; the ends of the geometric grid of poles are tried at a
+       few multiples of those */
+    b = beta*rate;
+    for (order=1; order<=AN_PL_MAXORDER && f->maxerr>tol; order++)
+        for (ilo=0; ilo<3; ilo++)
+            for (ihi=0; ihi<3; ihi++)
+            {
+                ulo = clo[ilo]/(horizon+b);
+                uhi = chi[ihi]/b;
+                for (i=0; i<order; i++)
+                    u[i] = (order==1) ? sqrt(ulo*uhi) : ulo*pow(uhi/ulo, (double)i/(order-1));
+                err = PowerLawSolve(b, horizon, order, u, g);
+                if (err<f->maxerr)
+                {
+                    f->maxerr = err;
+                    f->order  = order;
+                    for (i=0; i<order; i++) { ubest[i] = u[i]; f->gain[i] = g[i]; }
+                }
+            }
+    for (i=0; i<f->order; i++) f->pole[i] = exp(-ubest[i]);
+    return((f->maxerr<=tol) ? AN_OK : AN_EPARAM);
+}
+
+int PowerLawCached(PLFILTER *f, double beta, double rate, long horizon, double tol)
+{
+    /* not thread-safe: each worker process keeps its own cache */
+    static PLFILTER cache[AN_PL_NCACHE];
+    static int      ncache = 0, next = 0;
+    long   h;
+    int    i, err;
+
+    for (h=1024; h<horizon; h*=2);
+    for (i=0; i<ncache; i++)
+        if (cache[i].rate==rate && cache[i].beta==beta && cache[i].tol==tol && cache[i].horizon==h)
+        {
+            *f = cache[i];
+            return(AN_OK);
+        }
+    if ((err = PowerLawFit(f, beta, rate, h, tol)) != AN_OK) return(err);
+    cache[next] = *f;
+    next = (next+1) % AN_PL_NCACHE;
+    if (ncache<AN_PL_NCACHE) ncache++;
+    return(AN_OK);
+}
+
+double PowerLawStep(const PLFILTER *f, double *y, double x)
+{
+    double I = 0;
+    int    i;
+
+    for (i=0; i<f->order; i++)
+    {
+        y[i] = f->pole[i]*y[i] + f->gain[i]*x;
+        I   += y[i];
+    }
+    return(I);
+}
@@ -0,0 +1,38 @@
+#ifndef _POWERLAW_H
+#define _POWERLAW_H
+
+/* POWERLAW.H header file
+ * IIR approximations of the power-law kernels of the synapse model.  The actual implementation
+ * sums I(k) = sum_j sout(j)*binwidth/((k-j)*binwidth + beta), i.e. it convolves with
+ * h(n) = 1/(n + beta*sampFreq).  The fitter replaces h by a bank of parallel one-pole sections,
+ * h(n) ~ sum_i gain(i)*pole(i)^n, with the poles spread geometrically over the time scales of
+ * the kernel and the gains fitted by least squares to the relative error; the order is raised
+ * until the relative error over the first horizon samples is within the tolerance.
+*/
+
+#include "anmodel.h"
+
+#define AN_PL_MAXORDER 32
+#define AN_PL_TOL      1e-3   /* default relative error of the fitted kernels */
+
+typedef struct __PLFILTER
+{
+    double rate, beta;        /* sampling rate (Hz) and beta (s) of the kernel */
+    long   horizon;           /* samples over which the error is bounded */
+    double tol, maxerr;       /* requested and achieved maximum relative error */
+    int    order;
+    double pole[AN_PL_MAXORDER], gain[AN_PL_MAXORDER];
+} PLFILTER;
+
+/* Fit the kernel of beta at rate over horizon samples.  Returns AN_EPARAM if the tolerance
+   cannot be reached with AN_PL_MAXORDER sections (f then holds the best fit found). */
+int  PowerLawFit(PLFILTER *f, double beta, double rate, long horizon, double tol);
+/* Same, with the fits cached per (rate, beta, tolerance): the horizon is rounded up to a
+   power of two, so a fit is reused by all the simulations up to that length */
+int  PowerLawCached(PLFILTER *f, double beta, double rate, long horizon, double tol);
+
+/* Push the next input sample x through the filter, whose state is the section outputs
+   y[0..order-1] (zero at the start); returns the kernel sum */
+double PowerLawStep(const PLFILTER *f, double *y, double x);
+
+#endif
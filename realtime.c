@@ -0,0 +1,139 @@
+/*
+realtime.c runs a bank of model fibers on consecutive frames of a stimulus with a fixed
+latency, for use in real-time loops
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "anmodel.h"
+#include "ihcan.h"
+#include "synapse.h"
+#include "population.h"
+#include "realtime.h"
+
+/* Push n samples into the ring of a fiber and pop m samples from it */
+static void ANRTQueue(ANRTCHAN *ch, long size, const double *x, long n, double *y, long m)
+{
+    long i;
+
+    for (i=0; i<n; i++) ch->fifo[(ch->head+ch->count+i) % size] = x[i];
+    ch->count += n;
+    for (i=0; i<m; i++) y[i] = ch->fifo[(ch->head+i) % size];
+    ch->head   = (ch->head+m) % size;
+    ch->count -= m;
+}
+
+int ANRTInit(ANRT *rt, const ANPOPSPEC *spec, long frame, long maxsamp)
+{
+    double cf;
+    size_t bytes;
+    long   nbuf;
+    int    c, err;
+
+    memset(rt, 0, sizeof(ANRT));
+    ANWorkInit(&rt->work);
+    if (frame<1 || maxsamp<1 || ANPopCheck(spec)!=AN_OK || spec->product==AN_PROD_STATS) return(AN_EPARAM);
+    rt->spec    = spec;
+    rt->nchan   = ANPopNumItems(spec);
+    rt->stages  = ANPopStages(spec->product);
+    rt->frame   = frame;
+    rt->maxsamp = maxsamp;
+
+    /* every fiber is delayed by the largest lag of the bank, so that the frames line up */
+    if (rt->stages & AN_STAGE_SYNAPSE)
+        for (c=0; c<rt->nchan; c++)
+            rt->latency = __max(rt->latency, SynapseMaxLag(spec->tdres, ANPopSynRate(spec, spec->cf[c/spec->ntypes])));
+    nbuf = frame + rt->latency;
+
+    bytes = ANWorkRound(rt->nchan*sizeof(ANRTCHAN)) + 2*ANWorkRound(nbuf*sizeof(double))
+            + ANWorkRound(ANPopMaxSpikes(spec, nbuf)*sizeof(double)) + ANWorkRound(ANPopMaxSpikes(spec, nbuf)*sizeof(long))
+            + SpikeGeneratorWorkSize(nbuf);
+    for (c=0; c<rt->nchan; c++)
+    {
+        cf     = spec->cf[c/spec->ntypes];
+        bytes += IHCANWorkSize(cf, spec->tdres, spec->species, 1) + ANWorkRound(nbuf*sizeof(double));
+        if (rt->stages & AN_STAGE_SYNAPSE)
+            bytes += SynapseWorkSize(cf, spec->tdres, spec->implnt, ANPopSynRate(spec, cf), maxsamp);
+    }
+    if ((err = ANWorkReserve(&rt->work, bytes)) != AN_OK) return(err);
+
+    rt->chan    = (ANRTCHAN*)ANWorkCalloc(&rt->work, rt->nchan*sizeof(ANRTCHAN));
+    rt->ihcbuf  = (double*)ANWorkAlloc(&rt->work, nbuf*sizeof(double));
+    rt->synbuf  = (double*)ANWorkAlloc(&rt->work, nbuf*sizeof(double));
+    rt->sptime  = (double*)ANWorkAlloc(&rt->work, ANPopMaxSpikes(spec, nbuf)*sizeof(double));
+    rt->spindex = (long*)ANWorkAlloc(&rt->work, ANPopMaxSpikes(spec, nbuf)*sizeof(long));
+    if (rt->chan==NULL || rt->ihcbuf==NULL || rt->synbuf==NULL || rt->sptime==NULL || rt->spindex==NULL)
+    {
+        ANWorkFree(&rt->work);
+        return(AN_ENOMEM);
+    }
+    for (c=0; c<rt->nchan; c++)
+    {
+        ANRTCHAN *ch = rt->chan + c;
+
+        cf  = spec->cf[c/spec->ntypes];
+        err = IHCANInit(&ch->ihc, cf, spec->tdres, spec->cohc, spec->cihc, spec->species, 1, &rt->work);
+        ch->ihc.silence = spec->silence;
+        if (err==AN_OK && (rt->stages & AN_STAGE_SYNAPSE))
+            err = SynapseInit(&ch->syn, cf, spec->tdres, ANPopSpont(spec->fibertype[c%spec->ntypes]), spec->noiseType,
+                              spec->implnt, ANPopSynRate(spec, cf), maxsamp, spec->seed + 2*(uint64_t)c, &rt->work);
+        if (err!=AN_OK) { ANWorkFree(&rt->work); return(err); }
+        if (rt->stages & AN_STAGE_SPIKES)
+            SpikeGeneratorInit(&ch->sg, spec->tdres, maxsamp, spec->seed + 2*(uint64_t)c + 1, &rt->work);
+        /* the ring starts with latency zeros */
+        ch->fifo  = (double*)ANWorkCalloc(&rt->work, nbuf*sizeof(double));
+        ch->count = rt->latency;
+        if (ch->fifo==NULL) { ANWorkFree(&rt->work); return(AN_ENOMEM); }
+    }
+    return(AN_OK);
+}
+
+void ANRTFree(ANRT *rt)
+{
+    /* the sections' buffers all live in the workspace */
+    ANWorkFree(&rt->work);
+    rt->chan = NULL;
+}
+
+int ANRTProcess(ANRT *rt, const double *px, long n, double *out)
+{
+    clock_t  t0 = clock();
+    long     nsyn, size = rt->frame + rt->latency;
+    int      c, err;
+
+    if (n<0 || n>rt->frame || rt->nin+n>rt->maxsamp) return(AN_EPARAM);
+    for (c=0; c<rt->nchan; c++)
+    {
+        ANRTCHAN *ch = rt->chan + c;
+
+        if ((err = IHCANRun(&ch->ihc, px, n, rt->ihcbuf)) != AN_OK) return(err);
+        if (!(rt->stages & AN_STAGE_SYNAPSE))
+        {
+            ANRTQueue(ch, size, rt->ihcbuf, n, out + (size_t)c*n, n);
+            continue;
+        }
+        nsyn = SynapseRun(&ch->syn, rt->ihcbuf, n, rt->synbuf);
+        ANPopProduct(rt->spec->product, &ch->sg, rt->synbuf, nsyn, ch->nsyn, rt->sptime, rt->spindex);
+        ch->nsyn += nsyn;
+        ANRTQueue(ch, size, rt->synbuf, nsyn, out + (size_t)c*n, n);
+    }
+    rt->nin  += n;
+    rt->busy += (double)(clock()-t0)/CLOCKS_PER_SEC;
+    return(AN_OK);
+}
+
+int ANRTDrain(ANRT *rt, double *out)
+{
+    int c;
+
+    if (rt->nin<rt->maxsamp) return(AN_EPARAM);
+    for (c=0; c<rt->nchan; c++)
+        ANRTQueue(rt->chan + c, rt->frame + rt->latency, NULL, 0, out + (size_t)c*rt->latency, rt->latency);
+    return(AN_OK);
+}
+
+double ANRTFactor(const ANRT *rt)
+{
+    return((rt->nin>0) ? rt->busy/(rt->nin*rt->spec->tdres) : 0);
+}
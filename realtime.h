@@ -0,0 +1,58 @@
+#ifndef _REALTIME_H
+#define _REALTIME_H
+
+/* REALTIME.H header file
+ * frame-by-frame (real-time) processing of a bank of fibers, e.g. inside a hearing-aid loop:
+ * every call takes the next frame of the stimulus and returns exactly one frame of the
+ * product for each fiber.  All the sections are causal; the only algorithmic latency is that
+ * of the synapse's decimator and interpolator, so the output is latency samples behind the
+ * model response (zeros first).  The physiological delay of the model (the IHC delaypoint)
+ * is part of the response, not of the latency.  Nothing is allocated after ANRTInit.
+*/
+
+#include "anmodel.h"
+#include "ihcan.h"
+#include "synapse.h"
+#include "population.h"
+
+typedef struct __ANRTCHAN
+{
+    IHCSTATE ihc;
+    SYNSTATE syn;
+    SPKSTATE sg;
+    long     nsyn;      /* synapse output samples produced */
+    double  *fifo;      /* product samples waiting to be output (ring of latency+frame) */
+    long     head, count;
+} ANRTCHAN;
+
+typedef struct __ANRT
+{
+    const ANPOPSPEC *spec;  /* the fibers are the items of the population spec */
+    int     nchan, stages;
+    long    frame;          /* largest frame */
+    long    latency;        /* samples between the model response and the output */
+    long    maxsamp;        /* length of the session: the fGn is generated for it up front */
+    long    nin;            /* samples processed */
+    double  busy;           /* processor time spent in ANRTProcess (s) */
+
+    ANRTCHAN *chan;
+    double  *ihcbuf, *synbuf, *sptime;
+    long    *spindex;
+    ANWORK   work;          /* all the buffers of the bank */
+} ANRT;
+
+/* Set up the fibers of spec for frames of up to frame samples and a session of up to maxsamp
+   samples, which sets the length of the fGn and of the power-law kernels */
+int    ANRTInit(ANRT *rt, const ANPOPSPEC *spec, long frame, long maxsamp);
+void   ANRTFree(ANRT *rt);
+/* Process the next n <= frame samples of the stimulus px (in Pa); writes n samples of the
+   product for each fiber to out (fiber c at out[c*n]) */
+int    ANRTProcess(ANRT *rt, const double *px, long n, double *out);
+/* At the end of the session (after maxsamp samples): the last latency samples of each fiber
+   (fiber c at out[c*latency]) */
+int    ANRTDrain(ANRT *rt, double *out);
+/* Processor time per second of stimulus for the whole bank (so 1/(factor/nchan) channels
+   fit in real time on one core) */
+double ANRTFactor(const ANRT *rt);
+
+#endif
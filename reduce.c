@@ -0,0 +1,132 @@
+/*
+reduce.c reduces neurogram rows on the fly (binning, overlapping Hamming windows and
+decimation), so that only the reduced neurogram of a fiber has to be stored
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "anmodel.h"
+#include "reduce.h"
+
+static long ReducerHop(const ANREDSTAGE *s)
+{
+    if (s->type==AN_RED_HAMMING) return(s->len/2);
+    return(s->len);
+}
+
+static long ReducerWin(const ANREDSTAGE *s)
+{
+    return((s->type==AN_RED_DECIMATE) ? 1 : s->len);
+}
+
+int ReducerCheck(const ANREDSTAGE *stages, int nstage)
+{
+    int k;
+
+    if (nstage<0 || nstage>AN_RED_MAXSTAGE) return(AN_EPARAM);
+    for (k=0; k<nstage; k++)
+    {
+        if (stages[k].type<AN_RED_BIN || stages[k].type>AN_RED_DECIMATE) return(AN_EPARAM);
+        if (stages[k].len<((stages[k].type==AN_RED_HAMMING) ? 2 : 1)) return(AN_EPARAM);
+    }
+    return(AN_OK);
+}
+
+size_t ReducerWorkSize(const ANREDSTAGE *stages, int nstage)
+{
+    size_t bytes = 0;
+    int    k;
+
+    for (k=0; k<nstage; k++)
+        bytes += ANWorkRound(ReducerWin(stages+k)*sizeof(double)) + ANWorkRound(2*ReducerWin(stages+k)*sizeof(double));
+    return(bytes);
+}
+
+int ReducerInit(REDUCER *r, const ANREDSTAGE *stages, int nstage, ANWORK *work)
+{
+    double sum;
+    long   i, len;
+    int    k;
+
+    memset(r, 0, sizeof(REDUCER));
+    if (ReducerCheck(stages, nstage)!=AN_OK) return(AN_EPARAM);
+    r->nstage = nstage;
+    r->work   = work;
+    for (k=0; k<nstage; k++)
+    {
+        len = r->st[k].len = ReducerWin(stages+k);
+        r->st[k].hop = ReducerHop(stages+k);
+        r->st[k].w   = (double*)ANWorkAlloc(work,len*sizeof(double));
+        r->st[k].buf = (double*)ANWorkCalloc(work,2*len*sizeof(double));
+        if (r->st[k].w==NULL || r->st[k].buf==NULL)
+        {
+            ReducerFree(r);
+            return(AN_ENOMEM);
+        }
+        for (sum=0, i=0; i<len; i++)
+        {
+            r->st[k].w[i] = (stages[k].type==AN_RED_HAMMING) ? 0.54-0.46*cos(TWOPI*i/(len-1)) : 1.0;
+            sum += r->st[k].w[i];
+        }
+        for (i=0; i<len; i++) r->st[k].w[i] /= sum;
+    }
+    return(AN_OK);
+}
+
+void ReducerFree(REDUCER *r)
+{
+    int k;
+
+    /* released in the reverse order of their allocation */
+    for (k=r->nstage-1; k>=0; k--)
+    {
+        ANWorkRelease(r->work, r->st[k].buf); r->st[k].buf = NULL;
+        ANWorkRelease(r->work, r->st[k].w);   r->st[k].w = NULL;
+    }
+}
+
+long ReducerLength(const ANREDSTAGE *stages, int nstage, long n)
+{
+    int k;
+
+    for (k=0; k<nstage; k++)
+        n = (n<ReducerWin(stages+k)) ? 0 : (n-ReducerWin(stages+k))/ReducerHop(stages+k)+1;
+    return(n);
+}
+
+double ReducerFactor(const ANREDSTAGE *stages, int nstage)
+{
+    double f = 1;
+    int    k;
+
+    for (k=0; k<nstage; k++) f *= ReducerHop(stages+k);
+    return(f);
+}
+
+long ReducerRun(REDUCER *r, const double *x, long n, double *y)
+{
+    long   i, j, m, len;
+    int    k;
+    double acc, *win;
+
+    /* each stage writes no more outputs than it has read inputs, so it can work in place */
+    for (k=0; k<r->nstage; k++)
+    {
+        len = r->st[k].len;
+        for (m=0, i=0; i<n; i++)
+        {
+            r->st[k].buf[r->st[k].pos] = r->st[k].buf[r->st[k].pos+len] = x[i];
+            r->st[k].pos = (r->st[k].pos+1) % len;
+            r->st[k].nin++;
+            if (r->st[k].nin<len || (r->st[k].nin-len) % r->st[k].hop) continue;
+            win = r->st[k].buf + r->st[k].pos;   /* oldest input first */
+            for (acc=0, j=0; j<len; j++) acc += r->st[k].w[j]*win[j];
+            y[m++] = acc;
+        }
+        x = y; n = m;
+    }
+    if (r->nstage==0 && y!=x)
+        for (i=0; i<n; i++) y[i] = x[i];
+    return(n);
+}
@@ -0,0 +1,53 @@
+#ifndef _REDUCE_H
+#define _REDUCE_H
+
+/* REDUCE.H header file
+ * streaming reductions of a neurogram row: a cascade of up to AN_RED_MAXSTAGE stages, each
+ * a weighted mean over windows of len samples taken every hop samples.  Bins (e.g. the 0.5 ms
+ * PSTH bins of testANmodel.m), Hamming windows with 50% overlap (the ENV and TFS neurograms)
+ * and plain decimation are all of this form.  A window is only output once it is complete,
+ * so n input samples give n<len ? 0 : (n-len)/hop+1 outputs, however they are split up.
+*/
+
+#include "anmodel.h"
+
+#define AN_RED_MAXSTAGE 4
+
+#define AN_RED_BIN      1   /* mean over consecutive bins of len samples (hop = len) */
+#define AN_RED_HAMMING  2   /* Hamming-weighted mean over windows of len samples, hop = len/2 */
+#define AN_RED_DECIMATE 3   /* every len-th sample */
+
+typedef struct __ANREDSTAGE
+{
+    int  type;          /* AN_RED_ value */
+    long len;           /* samples at the input of the stage */
+} ANREDSTAGE;
+
+typedef struct __REDUCER
+{
+    int nstage;
+    struct
+    {
+        long   len, hop;    /* window length and step */
+        double *w;          /* weights of the window, summing to 1 */
+        double *buf;        /* last len inputs, stored twice so that the window is contiguous */
+        long   pos;
+        long   nin;         /* samples pushed */
+    } st[AN_RED_MAXSTAGE];
+
+    ANWORK *work;       /* workspace of w and buf (NULL for the heap) */
+} REDUCER;
+
+int    ReducerCheck(const ANREDSTAGE *stages, int nstage);
+int    ReducerInit(REDUCER *r, const ANREDSTAGE *stages, int nstage, ANWORK *work);
+/* Bytes taken from the workspace by ReducerInit */
+size_t ReducerWorkSize(const ANREDSTAGE *stages, int nstage);
+void   ReducerFree(REDUCER *r);
+/* Output samples of the cascade for n input samples, and the input samples per output */
+long   ReducerLength(const ANREDSTAGE *stages, int nstage, long n);
+double ReducerFactor(const ANREDSTAGE *stages, int nstage);
+/* Push x[0..n-1] through the cascade and write the completed outputs to y (which may be x);
+   returns their number */
+long   ReducerRun(REDUCER *r, const double *x, long n, double *y);
+
+#endif
@@ -0,0 +1,150 @@
+/*
+resample.c is a native replacement of the MATLAB resample() calls made by the synapse
+model and by ffGn, so that the synapse can run without calling back into MATLAB
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "anmodel.h"
+#include "resample.h"
+
+#define AN_RS_NCACHE 4   /* filter designs kept by ResamplerInit */
+
+/* Zeroth-order modified Bessel function of the first kind (power series) */
+static double BesselI0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    int k;
+
+    for (k=1; k<500; k++)
+    {
+        term *= 0.5*x/k;
+        sum  += term*term;
+        if (term*term < 1e-17*sum) break;
+    }
+    return(sum);
+}
+
+/* The design depends only on p and q, and the interpolator of the fGn has 20001 taps (at 10 kHz),
+   so the last few designs are kept (each worker process keeps its own; not thread-safe).  With
+   store 0, copies a kept design into r->h and returns 1, or returns 0 if there is none; with
+   store 1, keeps the design in r->h. */
+static int ResamplerCached(RESAMPLER *r, int store)
+{
+    static struct { int p, q; double *h; } cache[AN_RS_NCACHE];
+    static int ncache = 0, next = 0;
+    double *h;
+    int    i;
+
+    if (!store)
+    {
+        for (i=0; i<ncache; i++)
+            if (cache[i].p==r->p && cache[i].q==r->q)
+            {
+                memcpy(r->h, cache[i].h, r->nh*sizeof(double));
+                return(1);
+            }
+        return(0);
+    }
+    if ((h = (double*)malloc(r->nh*sizeof(double))) == NULL) return(0);   /* not kept */
+    memcpy(h, r->h, r->nh*sizeof(double));
+    if (ncache==AN_RS_NCACHE) free(cache[next].h);
+    cache[next].p = r->p; cache[next].q = r->q; cache[next].h = h;
+    next = (next+1) % AN_RS_NCACHE;
+    if (ncache<AN_RS_NCACHE) ncache++;
+    return(1);
+}
+
+size_t ResamplerWorkSize(int p, int q)
+{
+    size_t nh = 2*10*__max(p,q)+1;
+
+    return(ANWorkRound(nh*sizeof(double)) + ((p==1) ? ANWorkRound(2*nh*sizeof(double)) : 0));
+}
+
+int ResamplerInit(RESAMPLER *r, int p, int q, ANWORK *work)
+{
+    int    k, mx;
+    double fc, t, w, sum, bta = 5.0;
+
+    r->p = p; r->q = q;
+    mx      = __max(p,q);
+    r->half = 10*mx;
+    r->nh   = 2*r->half+1;
+    r->pos  = 0; r->nin = 0; r->nout = 0;
+    r->work = work;
+
+    r->h   = (double*)ANWorkAlloc(work,r->nh*sizeof(double));
+    r->buf = (p==1) ? (double*)ANWorkCalloc(work,2*r->nh*sizeof(double)) : NULL;
+    if (r->h==NULL || (p==1 && r->buf==NULL))
+    {
+        ResamplerFree(r);
+        return(AN_ENOMEM);
+    }
+
+    if (ResamplerCached(r, 0)) return(AN_OK);
+
+    /* With no transition band the least-squares design is the truncated ideal low-pass */
+    fc  = 1.0/2.0/mx;
+    sum = 0.0;
+    for (k=0; k<=r->half; k++)
+    {
+        t = k - r->half;
+        w = BesselI0(bta*sqrt(1.0-(t/r->half)*(t/r->half)))/BesselI0(bta);
+        if (t==0) r->h[k] = 2.0*fc;
+        else      r->h[k] = w*sin(TWOPI*fc*t)/(TWOPI/2*t);
+        r->h[r->nh-1-k] = r->h[k];
+    }
+    for (k=0; k<r->nh; k++) sum += r->h[k];
+    for (k=0; k<r->nh; k++) r->h[k] = p*r->h[k]/sum;
+
+    ResamplerCached(r, 1);
+    return(AN_OK);
+}
+
+void ResamplerFree(RESAMPLER *r)
+{
+    ANWorkRelease(r->work, r->h);   r->h = NULL;
+    ANWorkRelease(r->work, r->buf); r->buf = NULL;
+}
+
+int ResamplerPush(RESAMPLER *r, double x, double *y)
+{
+    long   j;
+    int    k;
+    double acc, *win;
+
+    r->buf[r->pos] = x;
+    r->buf[r->pos+r->nh] = x;
+    r->pos = (r->pos+1)%r->nh;
+    j = r->nin++;
+
+    /* output m is centred on input q*m, so it is complete once input q*m+half has arrived */
+    if (j<r->half || (j-r->half)%r->q!=0) return(0);
+
+    win = r->buf+r->pos;   /* oldest to newest */
+    acc = 0.0;
+    for (k=0; k<r->nh; k++)
+        acc += r->h[k]*win[k];
+    *y = acc;
+    r->nout++;
+    return(1);
+}
+
+double ResamplerInterp(const RESAMPLER *r, const double *x, long nx, long m)
+{
+    long   i, ilo, ihi, k;
+    double acc = 0.0;
+
+    /* y[m] = sum over i of x[i]*h[m+half-p*i], for the taps that fall inside the filter */
+    ihi = (m+r->half)/r->p;
+    ilo = __max(0, ihi-2*r->half/r->p);
+    if (ihi>nx-1) ihi = nx-1;
+    for (i=ilo; i<=ihi; i++)
+    {
+        k = m+r->half-r->p*i;
+        if (k>=0 && k<r->nh) acc += x[i]*r->h[k];
+    }
+    return(acc);
+}
@@ -0,0 +1,37 @@
+#ifndef _RESAMPLE_H
+#define _RESAMPLE_H
+
+/* RESAMPLE.H header file
+ * native version of MATLAB's resample(x,p,q) for the integer factors used by the model:
+ * decimation (p = 1), run sample by sample so that it can be checkpointed, and
+ * interpolation (q = 1) of a complete input sequence.
+ * The filter is the one designed by resample: firls(2*10*max(p,q),[0 2*fc 2*fc 1],[1 1 0 0])
+ * with fc = 1/2/max(p,q), times a Kaiser window with beta = 5, scaled by p/sum(h).
+*/
+
+#include "anmodel.h"
+
+typedef struct __RESAMPLER
+{
+    int    p, q;        /* interpolation and decimation factors */
+    int    nh, half;    /* number of taps (2*10*max(p,q)+1) and the group delay half = (nh-1)/2 */
+    double *h;          /* filter taps (symmetric) */
+
+    /* decimation state */
+    double *buf;        /* last nh inputs, stored twice so that the window is contiguous */
+    int    pos;
+    long   nin, nout;   /* samples pushed and output samples produced */
+
+    ANWORK *work;       /* workspace of h and buf (NULL for the heap) */
+} RESAMPLER;
+
+int    ResamplerInit(RESAMPLER *r, int p, int q, ANWORK *work);
+/* Bytes taken from the workspace by ResamplerInit */
+size_t ResamplerWorkSize(int p, int q);
+void   ResamplerFree(RESAMPLER *r);
+/* push the next input sample of a decimator (p==1); returns 1 and the next output in *y once it is complete */
+int    ResamplerPush(RESAMPLER *r, double x, double *y);
+/* m-th output sample of an interpolator (q==1) applied to the whole input x[0..nx-1] */
+double ResamplerInterp(const RESAMPLER *r, const double *x, long nx, long m);
+
+#endif
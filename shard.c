@@ -0,0 +1,265 @@
+/*
+shard.c runs a model population in several worker processes that share the stimulus and the
+neurogram through MAP_SHARED mappings.  Workers claim items with atomic operations on the
+item table (no locks), so faster workers simply take more items; the coordinator only waits
+for the workers, re-queues the items of any worker that died and starts a replacement.
+*/
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "anmodel.h"
+#include "population.h"
+#include "shard.h"
+#include "pipeline.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define AN_ALIGN(n) (((n)+63) & ~(size_t)63)
+
+int ANSharedCreate(ANSHARED *sh, long nitems, long nsamp, const ANSIGNAL *stim, const ANSIGNAL *out)
+{
+    size_t ctlsz, itemsz;
+    unsigned char *p;
+
+    memset(sh, 0, sizeof(ANSHARED));
+    if (nitems<1 || nsamp<1) return(AN_EPARAM);
+
+    ctlsz  = AN_ALIGN(sizeof(ANSHAREDCTL));
+    itemsz = nitems*sizeof(ANITEM);
+    sh->size = ctlsz+itemsz;
+
+    /* anonymous shared memory is zero-filled and is inherited by the forked workers */
+    p = (unsigned char*)mmap(NULL, sh->size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (p==(unsigned char*)MAP_FAILED) { sh->size = 0; return(AN_ENOMEM); }
+
+    sh->base   = p;
+    sh->nitems = nitems;
+    sh->nsamp  = nsamp;
+    sh->ctl    = (ANSHAREDCTL*)p;
+    sh->items  = (ANITEM*)(p+ctlsz);
+    sh->stim   = *stim;
+    sh->out    = *out;
+    return(AN_OK);
+}
+
+void ANSharedFree(ANSHARED *sh)
+{
+    if (sh->base!=NULL) munmap(sh->base, sh->size);
+    sh->base = NULL;
+}
+
+long ANSharedClaim(ANSHARED *sh, pid_t self)
+{
+    long i;
+
+    /* items that were never claimed are handed out in order */
+    while ((i = __sync_fetch_and_add(&sh->ctl->cursor, 1)) < sh->nitems)
+        if (__sync_bool_compare_and_swap(&sh->items[i].state, AN_ITEM_FREE, AN_ITEM_CLAIMED))
+            goto claimed;
+
+    /* then those re-queued after a failure */
+    if (sh->ctl->requeued>0)
+        for (i=0; i<sh->nitems; i++)
+            if ((sh->items[i].state==AN_ITEM_FREE) &&
+                __sync_bool_compare_and_swap(&sh->items[i].state, AN_ITEM_FREE, AN_ITEM_CLAIMED))
+            {
+                __sync_fetch_and_sub(&sh->ctl->requeued, 1);
+                goto claimed;
+            }
+    return(-1);
+
+claimed:
+    sh->items[i].owner = self;
+    sh->items[i].attempts++;
+    __sync_synchronize();
+    return(i);
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Workers */
+
+static void ShardWorker(const ANSHARDJOB *job, ANSHARED *sh, int w, const ANSHARDOPT *opt)
+{
+    pid_t  self = getpid();
+    long   i;
+    int    err;
+    ANWORK work, *pwork;
+    ANPIPE pipe, *ppipe = NULL;
+#ifdef __linux__
+    cpu_set_t set;
+    long      ncpu;
+
+    if (opt->pin)
+    {
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        CPU_ZERO(&set);
+        CPU_SET(w % (ncpu>0 ? ncpu : 1), &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+
+    /* one workspace serves all the items of the worker, so the model does not allocate after
+       this; if it cannot be reserved, the items allocate their own buffers */
+    ANWorkInit(&work);
+    pwork = (ANWorkReserve(&work, job->worksize)==AN_OK) ? &work : NULL;
+    if (opt->pipeline && ANPipeCreate(&pipe)==AN_OK) ppipe = &pipe;
+
+    while ((i = ANSharedClaim(sh, self)) >= 0)
+    {
+        err = job->run(job->ctx, sh, i, pwork, ppipe);
+        if (err==AN_EWORKER) _exit(1);   /* a stage of the pipeline died: the item is re-queued */
+        sh->items[i].err = err;
+        __sync_synchronize();   /* the row is complete before the item is marked */
+        /* model errors are deterministic, so they are not retried */
+        sh->items[i].state = (err==AN_OK) ? AN_ITEM_DONE : AN_ITEM_FAILED;
+    }
+    if (ppipe!=NULL) ANPipeFree(ppipe);
+    ANWorkFree(&work);
+    _exit(0);
+}
+
+static pid_t ShardStart(const ANSHARDJOB *job, ANSHARED *sh, int w, const ANSHARDOPT *opt)
+{
+    pid_t pid;
+
+    fflush(NULL);
+    pid = fork();
+    if (pid==0) ShardWorker(job, sh, w, opt);
+    return(pid);
+}
+
+/* Put the claimed items of a dead worker (or all the claimed items, if pid is 0) back in the queue */
+static long ShardRequeue(ANSHARED *sh, pid_t pid)
+{
+    long i, n = 0;
+
+    for (i=0; i<sh->nitems; i++)
+    {
+        if (sh->items[i].state!=AN_ITEM_CLAIMED || (pid!=0 && sh->items[i].owner!=pid)) continue;
+        if (sh->items[i].attempts>=AN_SHARD_MAXTRY)
+        {
+            sh->items[i].err   = AN_EWORKER;
+            sh->items[i].state = AN_ITEM_FAILED;
+            continue;
+        }
+        sh->items[i].owner = 0;
+        __sync_fetch_and_add(&sh->ctl->requeued, 1);
+        __sync_synchronize();
+        sh->items[i].state = AN_ITEM_FREE;
+        n++;
+    }
+    return(n);
+}
+
+static int ShardPending(const ANSHARED *sh)
+{
+    return((sh->ctl->cursor<sh->nitems) || (sh->ctl->requeued>0));
+}
+
+/* The items of a population are the rows of its neurogram */
+static int ShardPopItem(const void *ctx, ANSHARED *sh, long item, ANWORK *work, struct __ANPIPE *pipe)
+{
+    long skipped;
+    int  err;
+
+    err = ANPopRunItem((const ANPOPSPEC*)ctx, (int)item, &sh->stim, sh->nsamp, &sh->out, work, pipe, &skipped);
+    sh->items[item].skipped = skipped;
+    return(err);
+}
+
+void ANShardPopJob(ANSHARDJOB *job, const ANPOPSPEC *spec, long nsamp, int fmt, int pipeline)
+{
+    job->run      = ShardPopItem;
+    job->ctx      = spec;
+    job->worksize = ANPopMaxWorkSize(spec, nsamp, fmt);
+    job->peak     = ANPopPeakBytes(spec, nsamp, fmt, pipeline);
+}
+
+int ANShardRun(const ANPOPSPEC *spec, ANSHARED *sh, const ANSHARDOPT *opt)
+{
+    ANSHARDJOB job;
+
+    ANShardPopJob(&job, spec, sh->nsamp, sh->stim.fmt, opt->pipeline);
+    return(ANShardRunJob(&job, sh, opt));
+}
+
+size_t ANShardPeakBytes(const ANSHARDJOB *job, long nitems, int nw)
+{
+    return(AN_ALIGN(sizeof(ANSHAREDCTL)) + nitems*sizeof(ANITEM) + nw*(job->peak + sizeof(pid_t)));
+}
+
+int ANShardFitWorkers(const ANSHARDJOB *job, long nitems, const ANSHARDOPT *opt)
+{
+    int nw = __max(1, opt->nworkers);
+
+    if (opt->budget==0) return(nw);
+    while (nw>0 && ANShardPeakBytes(job, nitems, nw)>opt->budget) nw--;
+    return(nw);
+}
+
+int ANShardRunJob(const ANSHARDJOB *job, ANSHARED *sh, const ANSHARDOPT *opt)
+{
+    pid_t *pids, pid;
+    int    w, nw, alive, status, err = AN_OK;
+    long   i, nfail;
+
+    /* only as many workers as fit in the budget run at a time; the others' items wait */
+    nw = ANShardFitWorkers(job, sh->nitems, opt);
+    if (nw==0) return(AN_ENOMEM);
+    if (opt->verbose && nw<opt->nworkers)
+        fprintf(stderr, "memory budget: %d of %d workers (%.1f MB)\n", nw, opt->nworkers,
+                ANShardPeakBytes(job, sh->nitems, nw)/1048576.0);
+    pids = (pid_t*)calloc(nw, sizeof(pid_t));
+    if (pids==NULL) return(AN_ENOMEM);
+
+    do
+    {
+        alive = 0;
+        for (w=0; w<nw; w++)
+            if ((pids[w] = ShardStart(job, sh, w, opt)) > 0) alive++;
+        if (alive==0) { free(pids); return(AN_EWORKER); }
+
+        while (alive>0)
+        {
+            pid = waitpid(-1, &status, 0);
+            if (pid<0) break;
+            for (w=0; (w<nw) && (pids[w]!=pid); w++);
+            if (w==nw) continue;
+            pids[w] = 0;
+            alive--;
+
+            if (WIFEXITED(status) && WEXITSTATUS(status)==0) continue;
+
+            /* a worker died: hand its items to the others and replace it while work is left */
+            if (opt->verbose)
+                fprintf(stderr, "worker %d (pid %ld) failed; %ld item(s) re-queued\n",
+                        w, (long)pid, ShardRequeue(sh, pid));
+            else
+                ShardRequeue(sh, pid);
+            if (ShardPending(sh) && (pids[w] = ShardStart(job, sh, w, opt)) > 0) alive++;
+        }
+        /* items claimed by a worker that died before recording itself as the owner */
+    } while (ShardRequeue(sh, 0)>0);
+
+    free(pids);
+
+    for (i=0, nfail=0; i<sh->nitems; i++)
+        if (sh->items[i].state!=AN_ITEM_DONE)
+        {
+            if (opt->verbose)
+                fprintf(stderr, "item %ld failed: %s", i, ANErrorMessage(sh->items[i].err));
+            if (nfail++==0) err = (sh->items[i].err!=AN_OK) ? sh->items[i].err : AN_EWORKER;
+        }
+    return(nfail ? err : AN_OK);
+}
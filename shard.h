@@ -0,0 +1,91 @@
+#ifndef _SHARD_H
+#define _SHARD_H
+
+/* SHARD.H header file
+ * runs the work items of a population in several worker processes (POSIX only).
+ * The item table lives in a shared mapping, and the stimulus and the CF x time output are
+ * shared mappings (normally of the input and output files) that the workers inherit, so
+ * nothing is copied between processes; items are claimed without locks and the coordinator
+ * re-queues the items of a failed worker and starts a replacement.
+*/
+
+#include <sys/types.h>
+#include "population.h"
+
+#define AN_ITEM_FREE     0
+#define AN_ITEM_CLAIMED  1
+#define AN_ITEM_DONE     2
+#define AN_ITEM_FAILED   3
+
+#define AN_SHARD_MAXTRY  3   /* attempts at an item before it is marked as failed */
+
+typedef struct __ANITEM
+{
+    volatile int   state;
+    volatile pid_t owner;      /* worker holding the item while it is claimed */
+    volatile int   attempts;
+    volatile int   err;        /* model error code of the last attempt */
+    volatile long  skipped;    /* samples fast-forwarded through silence (see ANPopRunItem) */
+} ANITEM;
+
+/* Counters shared by all the processes (at the start of the mapping) */
+typedef struct __ANSHAREDCTL
+{
+    volatile long cursor;      /* next item never claimed */
+    volatile long requeued;    /* items put back by the coordinator and not yet claimed again */
+} ANSHAREDCTL;
+
+typedef struct __ANSHARED
+{
+    long   nsamp, nitems;
+    ANSHAREDCTL *ctl;
+    ANITEM *items;             /* nitems entries */
+    ANSIGNAL stim;             /* nsamp */
+    ANSIGNAL out;              /* nitems x nsamp, row per item; must be a MAP_SHARED mapping */
+    void   *base;              /* the mapping of ctl and items */
+    size_t  size;
+} ANSHARED;
+
+typedef struct __ANSHARDOPT
+{
+    int nworkers;
+    int pin;                   /* pin worker w to CPU w (mod the number of CPUs) */
+    int verbose;
+    int pipeline;              /* run the IHC sections of each fiber in two more processes (pipeline.h) */
+    size_t budget;             /* bytes the run may take (ANShardPeakBytes), 0 for no limit: fewer
+                                  workers are started if all of them would not fit */
+} ANSHARDOPT;
+
+/* Create the shared item table for nitems rows of nsamp samples of stim and out */
+int  ANSharedCreate(ANSHARED *sh, long nitems, long nsamp, const ANSIGNAL *stim, const ANSIGNAL *out);
+void ANSharedFree(ANSHARED *sh);
+
+/* Claim the next free item; returns -1 when there is none left */
+long ANSharedClaim(ANSHARED *sh, pid_t self);
+
+/* Run all the items of spec on sh->stim with opt->nworkers processes, writing sh->out in place.
+   Returns AN_OK, or the error of an item that failed AN_SHARD_MAXTRY times. */
+int  ANShardRun(const ANPOPSPEC *spec, ANSHARED *sh, const ANSHARDOPT *opt);
+
+/* Other kinds of items: run does item of sh (writing its results to sh->out) with buffers
+   from work and, if opt->pipeline is set, the pipe of the worker; worksize is the largest
+   workspace an item takes, and peak the most memory a worker takes (with that workspace) */
+typedef struct __ANSHARDJOB
+{
+    int    (*run)(const void *ctx, ANSHARED *sh, long item, ANWORK *work, struct __ANPIPE *pipe);
+    const void *ctx;
+    size_t worksize, peak;
+} ANSHARDJOB;
+
+int  ANShardRunJob(const ANSHARDJOB *job, ANSHARED *sh, const ANSHARDOPT *opt);
+/* The job ANShardRun makes of spec for a stimulus of nsamp samples in format fmt */
+void ANShardPopJob(ANSHARDJOB *job, const ANPOPSPEC *spec, long nsamp, int fmt, int pipeline);
+
+/* Peak memory of a run of nitems items of job by nw workers: the item table and the peak of
+   each worker.  The stimulus and the output are not included when they are mappings of files,
+   whose pages the kernel can write back or drop. */
+size_t ANShardPeakBytes(const ANSHARDJOB *job, long nitems, int nw);
+/* Workers (up to opt->nworkers) that fit in opt->budget: 0 if not even one does */
+int  ANShardFitWorkers(const ANSHARDJOB *job, long nitems, const ANSHARDOPT *opt);
+
+#endif
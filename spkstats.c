@@ -0,0 +1,180 @@
+/*
+spkstats.c keeps running statistics of spike trains (ISI histogram, vector strength, Fano
+factor and folded PSTH) as the spikes are generated, so that the spike times of long runs or
+many repetitions do not have to be stored and post-processed
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "anmodel.h"
+#include "spkstats.h"
+
+static long SpikeStatsBins(const SPKSTATSPEC *spec)
+{
+    return((spec->period>0) ? (long)ceil(spec->period/spec->psthbin - 1e-9) : 0);
+}
+
+int SpikeStatsCheck(const SPKSTATSPEC *spec)
+{
+    int i;
+
+    if (spec->nisi<0 || (spec->nisi>0 && !(spec->isibin>0))) return(AN_EPARAM);
+    if (spec->nfreq<0 || spec->nfreq>AN_STATS_MAXFREQ || spec->nwin<0 || spec->nwin>AN_STATS_MAXWIN) return(AN_EPARAM);
+    for (i=0; i<spec->nfreq; i++)
+        if (!(spec->freq[i]>0)) return(AN_EPARAM);
+    for (i=0; i<spec->nwin; i++)
+        if (!(spec->win[i]>0)) return(AN_EPARAM);
+    if (spec->period<0 || (spec->period>0 && !(spec->psthbin>0 && spec->psthbin<=spec->period))) return(AN_EPARAM);
+    return(AN_OK);
+}
+
+size_t SpikeStatsWorkSize(const SPKSTATSPEC *spec)
+{
+    return(ANWorkRound(spec->nisi*sizeof(double)) + ANWorkRound(SpikeStatsBins(spec)*sizeof(double)));
+}
+
+int SpikeStatsInit(SPKSTATS *s, const SPKSTATSPEC *spec, ANWORK *work)
+{
+    memset(s, 0, sizeof(SPKSTATS));
+    if (SpikeStatsCheck(spec)!=AN_OK) return(AN_EPARAM);
+    s->spec  = *spec;
+    s->work  = work;
+    s->last  = -1;
+    s->npsth = SpikeStatsBins(spec);
+    s->isi   = (spec->nisi>0) ? (double*)ANWorkCalloc(work, spec->nisi*sizeof(double)) : NULL;
+    s->psth  = (s->npsth>0) ? (double*)ANWorkCalloc(work, s->npsth*sizeof(double)) : NULL;
+    if ((spec->nisi>0 && s->isi==NULL) || (s->npsth>0 && s->psth==NULL))
+    {
+        SpikeStatsFree(s);
+        return(AN_ENOMEM);
+    }
+    return(AN_OK);
+}
+
+void SpikeStatsFree(SPKSTATS *s)
+{
+    ANWorkRelease(s->work, s->isi);  s->isi  = NULL;
+    ANWorkRelease(s->work, s->psth); s->psth = NULL;
+}
+
+/* Complete the counting window being counted, and the empty ones after it, up to window upto */
+static void SpikeStatsWindows(SPKSTATS *s, int i, long upto)
+{
+    double c = (double)s->fano[i].count;
+
+    if (upto<=s->fano[i].cur) return;
+    s->fano[i].n     += upto - s->fano[i].cur;
+    s->fano[i].sum   += c;
+    s->fano[i].sumsq += c*c;
+    s->fano[i].cur    = upto;
+    s->fano[i].count  = 0;
+}
+
+void SpikeStatsAdd(SPKSTATS *s, double t)
+{
+    const SPKSTATSPEC *spec = &s->spec;
+    double tr, ph;
+    long   b;
+    int    i;
+
+    s->nspikes++;
+    if (spec->nisi>0 && s->last>=0)
+    {
+        b = (long)floor((t-s->last)/spec->isibin);
+        s->isi[__min(b, spec->nisi-1)] += 1;
+    }
+    s->last = t;
+
+    tr = (spec->period>0) ? fmod(t, spec->period) : t;
+    for (i=0; i<spec->nfreq; i++)
+    {
+        ph = fmod(spec->freq[i]*tr, 1.0)*TWOPI;
+        s->vs[2*i]   += cos(ph);
+        s->vs[2*i+1] += sin(ph);
+    }
+    for (i=0; i<spec->nwin; i++)
+    {
+        SpikeStatsWindows(s, i, (long)floor(t/spec->win[i]));
+        s->fano[i].count++;
+    }
+    if (s->npsth>0)
+    {
+        b = (long)floor(tr/spec->psthbin);
+        s->psth[__min(b, s->npsth-1)] += 1;
+    }
+}
+
+void SpikeStatsClose(SPKSTATS *s, double T)
+{
+    int i;
+
+    /* the next train starts with its own first window */
+    for (i=0; i<s->spec.nwin; i++)
+    {
+        SpikeStatsWindows(s, i, (long)floor(T/s->spec.win[i] + 1e-9));
+        s->fano[i].cur   = 0;
+        s->fano[i].count = 0;
+    }
+    s->duration += T;
+    s->last = -1;
+}
+
+int SpikeStatsMerge(SPKSTATS *dst, const SPKSTATS *src)
+{
+    long i;
+
+    if (memcmp(&dst->spec, &src->spec, sizeof(SPKSTATSPEC))) return(AN_EPARAM);
+    dst->nspikes  += src->nspikes;
+    dst->duration += src->duration;
+    for (i=0; i<dst->spec.nisi; i++)
+        dst->isi[i] += src->isi[i];
+    for (i=0; i<2*dst->spec.nfreq; i++)
+        dst->vs[i] += src->vs[i];
+    for (i=0; i<dst->spec.nwin; i++)
+    {
+        dst->fano[i].n     += src->fano[i].n;
+        dst->fano[i].sum   += src->fano[i].sum;
+        dst->fano[i].sumsq += src->fano[i].sumsq;
+    }
+    for (i=0; i<dst->npsth; i++)
+        dst->psth[i] += src->psth[i];
+    return(AN_OK);
+}
+
+double SpikeStatsVS(const SPKSTATS *s, int i, double *phase)
+{
+    double c = s->vs[2*i], sn = s->vs[2*i+1];
+
+    if (phase!=NULL) *phase = atan2(sn, c);
+    return((s->nspikes>0) ? sqrt(c*c+sn*sn)/s->nspikes : 0.0);
+}
+
+double SpikeStatsFano(const SPKSTATS *s, int i, double *mean)
+{
+    double n = s->fano[i].n, m = (n>0) ? s->fano[i].sum/n : 0.0;
+
+    if (mean!=NULL) *mean = m;
+    return((m>0) ? __max(0, s->fano[i].sumsq/n - m*m)/m : 0.0);
+}
+
+long SpikeStatsLength(const SPKSTATSPEC *spec)
+{
+    return(2 + spec->nisi + 2*spec->nfreq + 2*spec->nwin + SpikeStatsBins(spec));
+}
+
+void SpikeStatsWrite(const SPKSTATS *s, double *v)
+{
+    long i;
+
+    *v++ = s->nspikes;
+    *v++ = s->duration;
+    for (i=0; i<s->spec.nisi; i++)
+        *v++ = s->isi[i];
+    for (i=0; i<s->spec.nfreq; i++, v+=2)
+        v[0] = SpikeStatsVS(s, (int)i, &v[1]);
+    for (i=0; i<s->spec.nwin; i++, v+=2)
+        v[0] = SpikeStatsFano(s, (int)i, &v[1]);
+    for (i=0; i<s->npsth; i++)
+        *v++ = s->psth[i];
+}
@@ -0,0 +1,71 @@
+#ifndef _SPKSTATS_H
+#define _SPKSTATS_H
+
+/* SPKSTATS.H header file
+ * running statistics of a spike train, updated by the spike generator as the spikes occur
+ * (see SPKSTATE.stats) so that the spike times need not be stored: an ISI histogram, the
+ * vector strength (synchronisation index) at some reference frequencies, the Fano factor of
+ * the counts in some counting windows and a PSTH folded over the repetitions of the stimulus.
+ * The memory is fixed by the spec, whatever the number of spikes or repetitions, and the
+ * statistics of several trains (e.g. run by different workers) can be merged.
+*/
+
+#include "anmodel.h"
+
+#define AN_STATS_MAXFREQ 8
+#define AN_STATS_MAXWIN  8
+
+typedef struct __SPKSTATSPEC
+{
+    int    nisi;                        /* ISI histogram of nisi bins of isibin s, the last of */
+    double isibin;                      /* which also counts the longer intervals (0 for none) */
+    int    nfreq;                       /* reference frequencies of the vector strength (Hz) */
+    double freq[AN_STATS_MAXFREQ];
+    int    nwin;                        /* counting windows of the Fano factor (s) */
+    double win[AN_STATS_MAXWIN];
+    double period, psthbin;             /* PSTH over repetitions of period s, in bins of psthbin s
+                                           (period 0 for none); the vector strength is also
+                                           taken from the time within the repetition */
+} SPKSTATSPEC;
+
+typedef struct __SPKSTATS
+{
+    SPKSTATSPEC spec;
+    long   npsth;
+    double nspikes, duration;           /* spikes counted and length of the train(s) closed (s) */
+    double last;                        /* time of the last spike (-1 before the first) */
+    double *isi;                        /* ISI counts (nisi) */
+    double vs[2*AN_STATS_MAXFREQ];      /* sums of the cosines and sines of the spike phases */
+    struct
+    {
+        long   cur, count;              /* window being counted and its count */
+        double n, sum, sumsq;           /* number of complete windows, sums of their counts and squares */
+    } fano[AN_STATS_MAXWIN];
+    double *psth;                       /* spike counts per bin (npsth) */
+    ANWORK *work;                       /* workspace of isi and psth (NULL for the heap) */
+} SPKSTATS;
+
+int    SpikeStatsCheck(const SPKSTATSPEC *spec);
+int    SpikeStatsInit(SPKSTATS *s, const SPKSTATSPEC *spec, ANWORK *work);
+/* Bytes taken from the workspace by SpikeStatsInit */
+size_t SpikeStatsWorkSize(const SPKSTATSPEC *spec);
+void   SpikeStatsFree(SPKSTATS *s);
+/* Count a spike at time t (s, from the start of the train); the spikes come in order */
+void   SpikeStatsAdd(SPKSTATS *s, double t);
+/* End of a train of duration T: the counting windows that end by T are complete, and the
+   spike that falls in the last (incomplete) one of each size is not counted in it */
+void   SpikeStatsClose(SPKSTATS *s, double T);
+/* Add the statistics of src (a closed train with the same spec) to those of dst */
+int    SpikeStatsMerge(SPKSTATS *dst, const SPKSTATS *src);
+
+/* Vector strength at freq[i] (and the mean phase, in radians), and Fano factor of the counts
+   in windows of win[i] s (and their mean) */
+double SpikeStatsVS(const SPKSTATS *s, int i, double *phase);
+double SpikeStatsFano(const SPKSTATS *s, int i, double *mean);
+/* The statistics as one vector of SpikeStatsLength values: the number of spikes and the
+   duration, the ISI histogram, the vector strength and mean phase at each frequency, the Fano
+   factor and mean count of each window and the PSTH */
+long   SpikeStatsLength(const SPKSTATSPEC *spec);
+void   SpikeStatsWrite(const SPKSTATS *s, double *v);
+
+#endif
@@ -0,0 +1,962 @@
+/* This is Version 5.2 of the code for auditory periphery model of:
+
+    Zilany, M.S.A., Bruce, I.C., Nelson, P.C., and Carney, L.H. (2009). "A Phenomenological
+        model of the synapse between the inner hair cell and auditory nerve : Long-term adaptation
+        with power-law dynamics," Journal of the Acoustical Society of America 126(5): 2390-2412.
+
+   with the modifications and simulation options described in:
+
+    Zilany, M.S.A., Bruce, I.C., Ibrahim, R.A., and Carney, L.H. (2013). "Improved parameters
+        and expanded simulation options for a model of the auditory periphery,"
+        in Abstracts of the 36th ARO Midwinter Research Meeting.
+
+   Humanization in this version includes:
+   - Human middle-ear filter, based on the linear middle-ear circuit model of Pascal et al. (JASA 1998)
+   - Human BM tuning, based on Shera et al. (PNAS 2002) or Glasberg & Moore (Hear. Res. 1990)
+   - Human frequency-offset of control-path filter (i.e., cochlear amplifier mechanism), based on Greenwood (JASA 1990)
+
+   The modifications to the BM tuning are described in:
+
+        Ibrahim, R. A., and Bruce, I. C. (2010). "Effects of peripheral tuning on the auditory nerve's representation
+            of speech envelope and temporal fine structure cues," in The Neurophysiological Bases of Auditory Perception,
+            eds. E. A. Lopez-Poveda and A. R. Palmer and R. Meddis, Springer, NY, pp. 429438.
+
+   Please cite these papers if you publish any research
+   results obtained with this code or any modified versions of this code.
+
+   See the file readme.txt for details of compiling and running the model.
+
+   %%%  M. S. Arefeen Zilany (msazilany@gmail.com), Ian C. Bruce (ibruce@ieee.org),
+         Rasha A. Ibrahim, Paul C. Nelson, and Laurel H. Carney - November 2013 %%%
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>      /* Added for MS Visual C++ compatability, by Ian Bruce, 1999 */
+
+#include "anmodel.h"
+#include "synapse.h"
+
+/* The fibers run together by SynapseRunFibers, as a structure of arrays (see below): one lane
+   per group of fibers of the same spontaneous rate for the exponential adaptation, and one per
+   fiber for the approximate power-law section */
+#define SYN_NGLANES 14      /* arrays of ngroup doubles */
+#define SYN_NFLANES 26      /* arrays of nfib doubles */
+typedef struct __SYNLANES
+{
+    int     ngroup, nfib;
+    double *CI, *CL, *PPI, *expon, *samp, *zero;        /* pools, release rate, output, decimated output */
+    double *strength, *slope, *CG, *PG, *PL, *rVI, *rVL, *rPGL;   /* rVI = tdres/VI, rPGL = 1/PG+1/PL */
+    double *x, *fgn, *I1, *I2;                          /* input of the power-law section */
+    double *s1a, *s1b, *s2a, *s2b;                      /* previous two inputs of its filters */
+    double *m1a, *m1b, *m2a, *m2b, *m3a, *m3b, *m4a, *m4b, *m5a, *m5b;
+    double *n1a, *n1b, *n2a, *n2b, *n3a, *n3b;          /* previous two outputs of each IIR section */
+    double *outa, *outb;                                /* last two power-law outputs */
+} SYNLANES;
+
+static void SynapsePowerLaw(SYNSTATE *st, double sampIHC);
+static void SynapsePush(SYNSTATE **order, const int *gstart, SYNLANES *L, const double *x, double **synout, long *nw);
+static void SynapseEmit(SYNSTATE *st, double *synout, long *nw);
+static void SynapseRunFibers(SYNSTATE **order, const int *gstart, int ngroup, double *lanes, const double *ihcout,
+                             long nsamp, double **synout, long *nw);
+
+/* Rate and lengths of the power-law section, as set up by SynapseInit */
+static void SynapseDims(double cf, double tdres, double *sampFreq, int *resamp, int *delaypoint)
+{
+    if (*sampFreq<=0) *sampFreq = 10e3; /* Sampling frequency used in the synapse */
+    *resamp     = (int) ceil(1/(tdres*(*sampFreq)));
+    if (fabs(*resamp*tdres*(*sampFreq)-1) > 1e-9) *sampFreq = 1/(*resamp*tdres);  /* the rate actually obtained */
+    *delaypoint = (int) floor(7500/(cf/1e3));
+}
+
+/* Factor of the slope of the rate-level function: the published values for spontaneous rates
+   of 0.1, 4 and 100 spikes/s, and a straight line through them on log-log axes for any other
+   rate (extended beyond the lowest and the highest) */
+static double SynapseCfFactor(double cf, double spont)
+{
+    double s[3], f[3];
+    int    i;
+
+    s[0] = 0.1; f[0] = __min(1.0,2.5e-4*cf*0.1+0.15);
+    s[1] = 4;   f[1] = __min(50,2.5e-4*cf*4+0.2);
+    s[2] = 100; f[2] = __min(800,pow(10,0.29*cf/1e3 + 0.7));
+    for (i=0; i<3; i++)
+        if (spont==s[i]) return(f[i]);
+    i = (spont<s[1]) ? 0 : 1;
+    return(f[i]*pow(f[i+1]/f[i], log(spont/s[i])/log(s[i+1]/s[i])));
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/*  Synapse model: if the time resolution is not small enough, the concentration of
+   the immediate pool could be as low as negative, at this time there is an alert message
+   print out and the concentration is set at saturated level  */
+/* --------------------------------------------------------------------------------------------*/
+/* SynapseInit, and SynapseInitState with draw 0: the fGn is then left for the checkpoint */
+static int SynapseSetup(SYNSTATE *st, double cf, double tdres, double spont, double noiseType, double implnt,
+                        double sampFreq, long totalstim, uint64_t seed, int draw, ANWORK *work)
+{
+    double cf_factor,PImax,kslope,Ass,Asp,TauR,TauST,Ar_Ast,PTS,Aon,AR,AST,Prest,gamma1,gamma2,k1,k2;
+    double VI0,VI1,alpha,beta,theta1,theta2,theta3,vsat,tmpst;
+    int    err;
+    ANRAND rng;
+
+    memset(st, 0, sizeof(SYNSTATE));
+    if (!(spont>0)) return(AN_EPARAM);
+    SynapseDims(cf, tdres, &sampFreq, &st->resamp, &st->delaypoint);
+    st->cf = cf; st->tdres = tdres; st->spont = spont; st->noiseType = noiseType; st->implnt = implnt;
+    st->totalstim  = totalstim;
+    st->sampFreq   = sampFreq;
+    st->work       = work;
+    st->nlow       = (long) floor((totalstim+2*st->delaypoint)*tdres*sampFreq);
+
+    /*----------------------------------------------------------*/
+    /*------- Parameters of the Power-law function -------------*/
+    /*----------------------------------------------------------*/
+    st->binwidth = 1/sampFreq;
+    /*alpha1 = 5e-6*100e3; beta1 = 5e-4; I1 = 0;*/ /* older version, 2012 and before */
+    st->alpha1 = 2.5e-6*100e3; st->beta1 = 5e-4; st->I1 = 0;
+    st->alpha2 = 1e-2*100e3;   st->beta2 = 1e-1; st->I2 = 0;
+    /* the hard-coded IIR coefficients of the approximate implementation are for 10 kHz only */
+    if (implnt==0 && sampFreq!=10e3)
+    {
+        st->fitted = 1;
+        if ((err = PowerLawCached(&st->pl1, st->beta1, sampFreq, st->nlow, AN_PL_TOL)) != AN_OK) return(err);
+        if ((err = PowerLawCached(&st->pl2, st->beta2, sampFreq, st->nlow, AN_PL_TOL)) != AN_OK) return(err);
+    }
+    /*----------------------------------------------------------*/
+    /*------- Generating a random sequence ---------------------*/
+    /*----------------------------------------------------------*/
+    ANRandSeed(&rng, (noiseType==0) ? 37 : seed);  /* fixed or variable fGn */
+    err = FFGNInit(&st->fgn, (long) ceil((totalstim+2*st->delaypoint)*tdres*sampFreq), 1/sampFreq, 0.9, spont,
+                   draw ? &rng : NULL, work);
+    if (err!=AN_OK) return(err);
+    err = ResamplerInit(&st->down, 1, st->resamp, work);
+    if (err!=AN_OK) { SynapseFree(st); return(err); }
+    if (implnt==1)
+    {
+        st->sout1hist = (double*)ANWorkAlloc(work,(st->nlow+1)*sizeof(double));
+        st->sout2hist = (double*)ANWorkAlloc(work,(st->nlow+1)*sizeof(double));
+        if (st->sout1hist==NULL || st->sout2hist==NULL) { SynapseFree(st); return(AN_ENOMEM); }
+    }
+    /*----------------------------------------------------------*/
+    /*----- Double Exponential Adaptation ----------------------*/
+    /*----------------------------------------------------------*/
+       cf_factor = SynapseCfFactor(cf, spont);
+
+       PImax  = 0.6;                /* PI2 : Maximum of the PI(PI at steady state) */
+       kslope = (1+50.0)/(5+50.0)*cf_factor*20.0*PImax;
+       /* Ass    = 300*TWOPI/2*(1+cf/100e3); */  /* Older value: Steady State Firing Rate eq.10 */
+       Ass    = 800*(1+cf/100e3);    /* Steady State Firing Rate eq.10 */
+
+       if (implnt==1 || st->fitted) Asp = spont*3.0;   /* Spontaneous Firing Rate if actual implementation */
+       if (implnt==0 && !st->fitted) Asp = spont*2.75; /* Spontaneous Firing Rate if approximate implementation */
+       TauR   = 2e-3;               /* Rapid Time Constant eq.10 */
+       TauST  = 60e-3;              /* Short Time Constant eq.10 */
+       Ar_Ast = 6;                  /* Ratio of Ar/Ast */
+       PTS    = 3;                  /* Peak to Steady State Ratio, characteristic of PSTH */
+
+       /* now get the other parameters */
+       Aon    = PTS*Ass;                          /* Onset rate = Ass+Ar+Ast eq.10 */
+       AR     = (Aon-Ass)*Ar_Ast/(1+Ar_Ast);      /* Rapid component magnitude: eq.10 */
+       AST    = Aon-Ass-AR;                       /* Short time component: eq.10 */
+       Prest  = PImax/Aon*Asp;                    /* eq.A15 */
+       st->CG = (Asp*(Aon-Asp))/(Aon*Prest*(1-Asp/Ass));    /* eq.A16 */
+       gamma1 = st->CG/Asp;                       /* eq.A19 */
+       gamma2 = st->CG/Ass;                       /* eq.A20 */
+       k1     = -1/TauR;                          /* eq.8 & eq.10 */
+       k2     = -1/TauST;                         /* eq.8 & eq.10 */
+               /* eq.A21 & eq.A22 */
+       VI0    = (1-PImax/Prest)/(gamma1*(AR*(k1-k2)/st->CG/PImax+k2/Prest/gamma1-k2/PImax/gamma2));
+       VI1    = (1-PImax/Prest)/(gamma1*(AST*(k2-k1)/st->CG/PImax+k1/Prest/gamma1-k1/PImax/gamma2));
+       st->VI = (VI0+VI1)/2;
+       alpha  = gamma2/k1/k2;       /* eq.A23,eq.A24 or eq.7 */
+       beta   = -(k1+k2)*alpha;     /* eq.A23 or eq.7 */
+       theta1 = alpha*PImax/st->VI;
+       theta2 = st->VI/PImax;
+       theta3 = gamma2-1/PImax;
+
+       st->PL = ((beta-theta2*theta3)/theta1-1)*PImax;  /* eq.4' */
+       st->PG = 1/(theta3-1/st->PL);                    /* eq.5' */
+       st->VL = theta1*st->PL*st->PG;                   /* eq.3' */
+       st->CI = Asp/Prest;                              /* CI at rest, from eq.A3,eq.A12 */
+       st->CL = st->CI*(Prest+st->PL)/st->PL;           /* CL at rest, from eq.1 */
+
+       if(kslope>=0)  vsat = kslope+Prest;
+       tmpst  = log(2)*vsat/Prest;
+       if(tmpst<400) st->synstrength = log(exp(tmpst)-1);
+       else st->synstrength = tmpst;
+       st->synslope = Prest/log(2)*st->synstrength;
+
+    return(AN_OK);
+}
+
+int SynapseInit(SYNSTATE *st, double cf, double tdres, double spont, double noiseType, double implnt,
+                double sampFreq, long totalstim, uint64_t seed, ANWORK *work)
+{
+    return(SynapseSetup(st, cf, tdres, spont, noiseType, implnt, sampFreq, totalstim, seed, 1, work));
+}
+
+int SynapseInitState(SYNSTATE *st, double cf, double tdres, double spont, double noiseType, double implnt,
+                     double sampFreq, long totalstim, ANBLOB *blob, ANWORK *work)
+{
+    int err;
+
+    err = SynapseSetup(st, cf, tdres, spont, noiseType, implnt, sampFreq, totalstim, 0, 0, work);
+    if (err!=AN_OK) return(err);
+    if ((err = SynapseLoadState(st, blob)) != AN_OK) SynapseFree(st);
+    return(err);
+}
+
+void SynapseFree(SYNSTATE *st)
+{
+    FFGNFree(&st->fgn);
+    ResamplerFree(&st->down);
+    ANWorkRelease(st->work, st->sout1hist); st->sout1hist = NULL;
+    ANWorkRelease(st->work, st->sout2hist); st->sout2hist = NULL;
+}
+
+size_t SynapseWorkSize(double cf, double tdres, double implnt, double sampFreq, long totalstim)
+{
+    int    resamp, delaypoint;
+    long   nlow;
+    size_t bytes;
+
+    SynapseDims(cf, tdres, &sampFreq, &resamp, &delaypoint);
+    nlow  = (long) floor((totalstim+2*delaypoint)*tdres*sampFreq);
+    bytes = FFGNWorkSize((long) ceil((totalstim+2*delaypoint)*tdres*sampFreq), 1/sampFreq, 0.9)
+            + ResamplerWorkSize(1, resamp);
+    if (implnt==1) bytes += 2*ANWorkRound((nlow+1)*sizeof(double));
+    return(bytes);
+}
+
+long SynapseMaxLag(double tdres, double sampFreq)
+{
+    int resamp, delaypoint;
+
+    SynapseDims(1e3, tdres, &sampFreq, &resamp, &delaypoint);
+    return(12*(long)resamp);
+}
+
+long SynapseMaxOutput(const SYNSTATE *st, long nsamp)
+{
+    return(nsamp + (st->nin - st->nout));
+}
+
+long SynapseRun(SYNSTATE *st, const double *ihcout, long nsamp, double *synout)
+{
+    double lanes[SYN_NGLANES+SYN_NFLANES];
+    int    gstart[2] = {0, 1};
+    long   nw = 0;
+
+    SynapseRunFibers(&st, gstart, 1, lanes, ihcout, nsamp, &synout, &nw);
+    return(nw);
+}
+
+/* The approximate power-law section with the filters fitted at 10 kHz runs in the lanes */
+static int SynapseLanesPL(const SYNSTATE *st)
+{
+    return(st->implnt==0 && !st->fitted);
+}
+
+static double *SynapseLane(double **buf, int n)
+{
+    double *p = *buf;
+
+    *buf += n;
+    return(p);
+}
+
+/* Set up the lanes in buf from the state of the fibers */
+static void SynapseLanesLoad(SYNLANES *L, double *buf, SYNSTATE **order, const int *gstart, int ngroup)
+{
+    SYNSTATE *st;
+    int       g, j, n = gstart[ngroup];
+
+    L->ngroup = ngroup;
+    L->nfib   = n;
+    L->CI  = SynapseLane(&buf, ngroup);  L->CL = SynapseLane(&buf, ngroup);  L->PPI = SynapseLane(&buf, ngroup);
+    L->expon = SynapseLane(&buf, ngroup);  L->samp = SynapseLane(&buf, ngroup);  L->zero = SynapseLane(&buf, ngroup);
+    L->strength = SynapseLane(&buf, ngroup);  L->slope = SynapseLane(&buf, ngroup);
+    L->CG  = SynapseLane(&buf, ngroup);  L->PG = SynapseLane(&buf, ngroup);  L->PL  = SynapseLane(&buf, ngroup);
+    L->rVI = SynapseLane(&buf, ngroup);  L->rVL = SynapseLane(&buf, ngroup); L->rPGL = SynapseLane(&buf, ngroup);
+    L->x   = SynapseLane(&buf, n);  L->fgn = SynapseLane(&buf, n);  L->I1  = SynapseLane(&buf, n);  L->I2  = SynapseLane(&buf, n);
+    L->s1a = SynapseLane(&buf, n);  L->s1b = SynapseLane(&buf, n);  L->s2a = SynapseLane(&buf, n);  L->s2b = SynapseLane(&buf, n);
+    L->m1a = SynapseLane(&buf, n);  L->m1b = SynapseLane(&buf, n);  L->m2a = SynapseLane(&buf, n);  L->m2b = SynapseLane(&buf, n);
+    L->m3a = SynapseLane(&buf, n);  L->m3b = SynapseLane(&buf, n);  L->m4a = SynapseLane(&buf, n);  L->m4b = SynapseLane(&buf, n);
+    L->m5a = SynapseLane(&buf, n);  L->m5b = SynapseLane(&buf, n);
+    L->n1a = SynapseLane(&buf, n);  L->n1b = SynapseLane(&buf, n);  L->n2a = SynapseLane(&buf, n);  L->n2b = SynapseLane(&buf, n);
+    L->n3a = SynapseLane(&buf, n);  L->n3b = SynapseLane(&buf, n);
+    L->outa = SynapseLane(&buf, n); L->outb = SynapseLane(&buf, n);
+
+    for (g=0; g<ngroup; g++)
+    {
+        st = order[gstart[g]];
+        L->CI[g]  = st->CI;  L->CL[g] = st->CL;  L->PPI[g] = st->PPIlast;  L->expon[g] = st->exponlast;
+        L->zero[g] = 0.0;
+        L->strength[g] = st->synstrength;  L->slope[g] = st->synslope;
+        L->CG[g]  = st->CG;  L->PG[g] = st->PG;  L->PL[g] = st->PL;
+        L->rVI[g] = st->tdres/st->VI;  L->rVL[g] = st->tdres/st->VL;  L->rPGL[g] = 1/st->PG+1/st->PL;
+    }
+    if (!SynapseLanesPL(order[0])) return;
+    for (j=0; j<n; j++)
+    {
+        st = order[j];
+        L->I1[j]  = st->I1;  L->I2[j] = st->I2;
+        L->s1a[j] = st->sout1[0]; L->s1b[j] = st->sout1[1]; L->s2a[j] = st->sout2[0]; L->s2b[j] = st->sout2[1];
+        L->m1a[j] = st->m1[0]; L->m1b[j] = st->m1[1]; L->m2a[j] = st->m2[0]; L->m2b[j] = st->m2[1];
+        L->m3a[j] = st->m3[0]; L->m3b[j] = st->m3[1]; L->m4a[j] = st->m4[0]; L->m4b[j] = st->m4[1];
+        L->m5a[j] = st->m5[0]; L->m5b[j] = st->m5[1];
+        L->n1a[j] = st->n1[0]; L->n1b[j] = st->n1[1]; L->n2a[j] = st->n2[0]; L->n2b[j] = st->n2[1];
+        L->n3a[j] = st->n3[0]; L->n3b[j] = st->n3[1];
+        L->outa[j] = st->synSampOut[0]; L->outb[j] = st->synSampOut[1];
+    }
+}
+
+/* Store the lanes back in the state of the fibers */
+static void SynapseLanesStore(const SYNLANES *L, SYNSTATE **order, const int *gstart)
+{
+    SYNSTATE *st;
+    int       g, j;
+
+    for (g=0; g<L->ngroup; g++)
+        for (j=gstart[g]; j<gstart[g+1]; j++)
+        {
+            st = order[j];
+            st->CI = L->CI[g];  st->CL = L->CL[g];  st->PPIlast = L->PPI[g];  st->exponlast = L->expon[g];
+        }
+    if (!SynapseLanesPL(order[0])) return;
+    for (j=0; j<L->nfib; j++)
+    {
+        st = order[j];
+        st->I1 = L->I1[j];  st->I2 = L->I2[j];
+        st->sout1[0] = L->s1a[j]; st->sout1[1] = L->s1b[j]; st->sout2[0] = L->s2a[j]; st->sout2[1] = L->s2b[j];
+        st->m1[0] = L->m1a[j]; st->m1[1] = L->m1b[j]; st->m2[0] = L->m2a[j]; st->m2[1] = L->m2b[j];
+        st->m3[0] = L->m3a[j]; st->m3[1] = L->m3b[j]; st->m4[0] = L->m4a[j]; st->m4[1] = L->m4b[j];
+        st->m5[0] = L->m5a[j]; st->m5[1] = L->m5b[j];
+        st->n1[0] = L->n1a[j]; st->n1[1] = L->n1b[j]; st->n2[0] = L->n2a[j]; st->n2[1] = L->n2b[j];
+        st->n3[0] = L->n3a[j]; st->n3[1] = L->n3b[j];
+        st->synSampOut[0] = L->outa[j]; st->synSampOut[1] = L->outb[j];
+    }
+}
+
+/* One sample of the exponential adaptation of each group, from its release rate PPI.  When
+   the immediate pool would go negative (tdres too coarse), both pools are set to saturation
+   instead: both outcomes are computed and one is selected, so that the lanes do not branch. */
+static void SynapseExpLanes(SYNLANES *L)
+{
+    double CI, CL, CIsat, CLsat;
+    int    g;
+
+    for (g=0; g<L->ngroup; g++)
+    {
+        CI    = L->CI[g] + L->rVI[g]*(-L->PPI[g]*L->CI[g] + L->PL[g]*(L->CL[g]-L->CI[g]));
+        CL    = L->CL[g] + L->rVL[g]*(-L->PL[g]*(L->CL[g] - L->CI[g]) + L->PG[g]*(L->CG[g] - L->CL[g]));
+        CIsat = L->CG[g]/(L->PPI[g]*(L->rPGL[g]+1/L->PPI[g]));
+        CLsat = CIsat*(L->PPI[g]+L->PL[g])/L->PL[g];
+        L->CI[g]    = (CI<0) ? CIsat : CI;
+        L->CL[g]    = (CI<0) ? CLsat : CL;
+        L->expon[g] = L->CI[g]*L->PPI[g];
+    }
+}
+
+/* One sample of the approximate power-law section of each fiber, from its input x and fGn
+   sample.  The filters start from rest, so that their first two samples need no special form. */
+static void SynapsePowerLawLanes(SYNLANES *L, double alpha1, double alpha2)
+{
+    double sout1, sout2, m1, m2, m3, m4, m5, n1, n2, n3;
+    int    j;
+
+    for (j=0; j<L->nfib; j++)
+    {
+        sout1  = __max( 0, L->x[j] + L->fgn[j] - alpha1*L->I1[j]);
+        sout2  = __max( 0, L->x[j] - alpha2*L->I2[j]);
+
+        n1 = 1.992127932802320*L->n1a[j] - 0.992140616993846*L->n1b[j]+ 1.0e-3*(sout2 - 0.994466986569624*L->s2a[j] + 0.000000000002347*L->s2b[j]);
+        n2 = 1.999195329360981*L->n2a[j] - 0.999195402928777*L->n2b[j]+n1 - 1.997855276593802*L->n1a[j] + 0.997855827934345*L->n1b[j];
+        n3 =-0.798261718183851*L->n3a[j] - 0.199131619873480*L->n3b[j]+n2 + 0.798261718184977*L->n2a[j] + 0.199131619874064*L->n2b[j];
+        L->I2[j] = n3;
+
+        m1 = 0.491115852967412*L->m1a[j] - 0.055050209956838*L->m1b[j]+ 0.2*(sout1- 0.173492003319319*L->s1a[j]+ 0.000000172983796*L->s1b[j]);
+        m2 = 1.084520302502860*L->m2a[j] - 0.288760329320566*L->m2b[j] + m1 - 0.803462163297112*L->m1a[j] + 0.154962026341513*L->m1b[j];
+        m3 = 1.588427084535629*L->m3a[j] - 0.628138993662508*L->m3b[j] + m2 - 1.416084732997016*L->m2a[j] + 0.496615555008723*L->m2b[j];
+        m4 = 1.886287488516458*L->m4a[j] - 0.888972875389923*L->m4b[j] + m3 - 1.830362725074550*L->m3a[j] + 0.836399964176882*L->m3b[j];
+        m5 = 1.989549282714008*L->m5a[j] - 0.989558985673023*L->m5b[j] + m4 - 1.983165053215032*L->m4a[j] + 0.983193027347456*L->m4b[j];
+        L->I1[j] = m5;
+
+        L->n1b[j] = L->n1a[j]; L->n1a[j] = n1;
+        L->n2b[j] = L->n2a[j]; L->n2a[j] = n2;
+        L->n3b[j] = L->n3a[j]; L->n3a[j] = n3;
+        L->m1b[j] = L->m1a[j]; L->m1a[j] = m1;
+        L->m2b[j] = L->m2a[j]; L->m2a[j] = m2;
+        L->m3b[j] = L->m3a[j]; L->m3a[j] = m3;
+        L->m4b[j] = L->m4a[j]; L->m4a[j] = m4;
+        L->m5b[j] = L->m5a[j]; L->m5a[j] = m5;
+        L->s1b[j] = L->s1a[j]; L->s1a[j] = sout1;
+        L->s2b[j] = L->s2a[j]; L->s2a[j] = sout2;
+        L->outa[j] = L->outb[j]; L->outb[j] = sout1 + sout2;
+    }
+}
+
+/* Run the fibers order[0] to order[gstart[ngroup]-1] of one CF on the same IHC output.  The
+   fibers of group g (order[gstart[g]] to order[gstart[g+1]-1]) have the same spontaneous rate
+   and differ only in their fGn, so the exponential adaptation and the decimator of the first
+   of them serve the group; the groups differ only in the constants of the exponential
+   adaptation, so they all advance in step, sharing the test for a steady input.  Each fiber
+   appends its output to synout[j] at nw[j]; lanes has room for SYN_NGLANES*ngroup +
+   SYN_NFLANES*gstart[ngroup] doubles. */
+static void SynapseRunFibers(SYNSTATE **order, const int *gstart, int ngroup, double *lanes, const double *ihcout,
+                             long nsamp, double **synout, long *nw)
+{
+    SYNSTATE *st = order[0];
+    SYNLANES  L;
+    double    tmp;
+    long      indx, k;
+    int       g, j;
+
+    SynapseLanesLoad(&L, lanes, order, gstart, ngroup);
+
+    for (indx=0; (indx<nsamp) && (st->nin<st->totalstim); ++indx)
+    {
+        if (st->nin>0 && ihcout[indx]==st->ihclast)
+            st->nquiet++;   /* steady input (silence): the release rates stay, and the pools only relax */
+        else
+        {
+            for (g=0; g<ngroup; g++)
+            {
+                tmp = L.strength[g]*(ihcout[indx]);
+                if(tmp<400) tmp = log(1+exp(tmp));
+                L.PPI[g] = L.slope[g]/L.strength[g]*tmp;
+            }
+            st->ihclast = ihcout[indx];
+        }
+
+        SynapseExpLanes(&L);
+
+        /* The power-law section sees the exponential adaptation output padded with delaypoint
+           copies of its first sample at the start and 2*delaypoint copies of its last one at the end */
+        if (st->nin==0)
+        {
+            for (g=0; g<ngroup; g++)
+                order[gstart[g]]->expon0 = L.expon[g];
+            for (k=0; k<st->delaypoint; k++)
+                SynapsePush(order, gstart, &L, L.expon, synout, nw);
+        }
+        SynapsePush(order, gstart, &L, L.expon, synout, nw);
+        st->nin++;
+    }
+
+    if ((st->nin==st->totalstim) && (st->nout<st->totalstim))
+    {
+        if (st->down.nin < st->totalstim+3*st->delaypoint)
+            for (k=0; k<2*st->delaypoint; k++)
+                SynapsePush(order, gstart, &L, L.expon, synout, nw);
+        while (st->k<st->nlow)
+            SynapsePush(order, gstart, &L, L.zero, synout, nw);  /* zero padding at the end of the resampled signal */
+        for (j=0; j<L.nfib; j++)
+            SynapseEmit(order[j], synout[j], &nw[j]);
+    }
+
+    SynapseLanesStore(&L, order, gstart);
+
+    /* the other fibers follow the shared part (all but the decimator's history) */
+    for (g=0; g<ngroup; g++)
+        for (j=gstart[g]; j<gstart[g+1]; j++)
+        {
+            order[j]->expon0  = order[gstart[g]]->expon0;
+            order[j]->ihclast = st->ihclast;
+            order[j]->nin = st->nin; order[j]->nquiet = st->nquiet;
+        }
+}
+
+/* Push one sample of the padded exponential-adaptation output of each group (x[g]) through
+   its decimator, and run the power-law section and the upsampling of each fiber whenever a
+   decimated sample is complete (the decimators run in step) */
+static void SynapsePush(SYNSTATE **order, const int *gstart, SYNLANES *L, const double *x, double **synout, long *nw)
+{
+    SYNSTATE *st;
+    int       g, j, ready = 0;
+
+    for (g=0; g<L->ngroup; g++)
+        ready = ResamplerPush(&order[gstart[g]]->down, x[g], &L->samp[g]);
+    if (!ready) return;
+    if (order[0]->k>=order[0]->nlow) return;
+
+    if (SynapseLanesPL(order[0]))
+    {
+        for (g=0; g<L->ngroup; g++)
+            for (j=gstart[g]; j<gstart[g+1]; j++)
+            {
+                L->x[j]   = L->samp[g];
+                L->fgn[j] = FFGNSample(&order[j]->fgn, order[j]->k);
+            }
+        SynapsePowerLawLanes(L, order[0]->alpha1, order[0]->alpha2);
+        for (j=0; j<L->nfib; j++)
+        {
+            st = order[j];
+            st->synSampOut[0] = L->outa[j]; st->synSampOut[1] = L->outb[j];
+            st->k++;
+            SynapseEmit(st, synout[j], &nw[j]);
+        }
+    }
+    else
+        for (g=0; g<L->ngroup; g++)
+            for (j=gstart[g]; j<gstart[g+1]; j++)
+            {
+                SynapsePowerLaw(order[j], L->samp[g]);
+                SynapseEmit(order[j], synout[j], &nw[j]);
+            }
+}
+
+/* Write the synapse output samples whose interpolation interval is now complete */
+static void SynapseEmit(SYNSTATE *st, double *synout, long *nw)
+{
+    long   z, b;
+    double incr;
+
+    while (st->nout<st->totalstim)
+    {
+        z = (st->nout+st->delaypoint)/st->resamp;
+        b = (st->nout+st->delaypoint)%st->resamp;
+        if (z>=st->nlow-1)
+        {
+            if (st->k<st->nlow) break;
+            synout[(*nw)++] = 0.0;  /* past the last interpolation interval */
+        }
+        else if (z+1<st->k)
+        {
+            /*----- Upsampling to original (High 100 kHz) sampling rate --------*/
+            incr = (st->synSampOut[1]-st->synSampOut[0])/st->resamp;
+            synout[(*nw)++] = st->synSampOut[0]+ b*incr;
+        }
+        else break;
+        st->nout++;
+    }
+}
+
+/* One sample of the power-law adaptation, at sampFreq, by the actual implementation or the
+   kernels fitted for sampFreq (the filters fitted at 10 kHz run in SynapsePowerLawLanes) */
+static void SynapsePowerLaw(SYNSTATE *st, double sampIHC)
+{
+    long   j, k = st->k;
+    double sout1, sout2;
+    double binwidth = st->binwidth;
+
+    sout1  = __max( 0, sampIHC + FFGNSample(&st->fgn,k)- st->alpha1*st->I1);
+    /*sout1  = __max( 0, sampIHC - alpha1*I1); */   /* No fGn condition */
+    sout2  = __max( 0, sampIHC - st->alpha2*st->I2);
+
+    if (st->implnt==1)    /* ACTUAL Implementation */
+    {
+        st->sout1hist[k] = sout1; st->sout2hist[k] = sout2;
+        st->I1 = 0; st->I2 = 0;
+        for (j=0; j<k+1; ++j)
+        {
+            st->I1 += (st->sout1hist[j])*binwidth/((k-j)*binwidth + st->beta1);
+            st->I2 += (st->sout2hist[j])*binwidth/((k-j)*binwidth + st->beta2);
+        }
+    } /* end of actual */
+
+    if (st->implnt==0 && st->fitted)    /* APPROXIMATE Implementation, kernels fitted for sampFreq */
+    {
+        st->I1 = PowerLawStep(&st->pl1, st->y1, sout1);
+        st->I2 = PowerLawStep(&st->pl2, st->y2, sout2);
+    }
+
+
+    st->sout1[1] = st->sout1[0]; st->sout1[0] = sout1;
+    st->sout2[1] = st->sout2[0]; st->sout2[0] = sout2;
+
+    st->synSampOut[0] = st->synSampOut[1];
+    st->synSampOut[1] = sout1 + sout2;
+    st->k = k+1;
+}
+/* -------------------------------------------------------------------------------------------- */
+/* Banks: the fibers are set up in the given order and grouped by spontaneous rate (in order of
+   first appearance), and all the groups are run by SynapseRunFibers */
+
+int SynapseBankInit(SYNBANK *b, double cf, double tdres, const double *spont, int nfib, double noiseType,
+                    double implnt, double sampFreq, long totalstim, uint64_t seed, ANWORK *work)
+{
+    int i, j, n, err;
+
+    memset(b, 0, sizeof(SYNBANK));
+    if (nfib<1) return(AN_EPARAM);
+    b->work   = work;
+    b->fib    = (SYNSTATE*)ANWorkCalloc(work, nfib*sizeof(SYNSTATE));
+    b->order  = (SYNSTATE**)ANWorkAlloc(work, nfib*sizeof(SYNSTATE*));
+    b->gstart = (int*)ANWorkAlloc(work, (nfib+1)*sizeof(int));
+    b->out    = (double**)ANWorkAlloc(work, nfib*sizeof(double*));
+    b->nw     = (long*)ANWorkAlloc(work, nfib*sizeof(long));
+    b->lanes  = (double*)ANWorkAlloc(work, (SYN_NGLANES+SYN_NFLANES)*nfib*sizeof(double));
+    if (b->fib==NULL || b->order==NULL || b->gstart==NULL || b->out==NULL || b->nw==NULL || b->lanes==NULL)
+    {
+        SynapseBankFree(b);
+        return(AN_ENOMEM);
+    }
+
+    for (i=0; i<nfib; i++)
+    {
+        err = SynapseInit(&b->fib[i], cf, tdres, spont[i], noiseType, implnt, sampFreq, totalstim, seed+(uint64_t)i, work);
+        if (err!=AN_OK) { SynapseBankFree(b); return(err); }
+        b->nfib++;
+    }
+
+    /* order[] lists the fibers group by group; gstart[g] is the first of group g */
+    for (i=0, n=0; i<nfib; i++)
+    {
+        for (j=0; (j<i) && (spont[j]!=spont[i]); j++);
+        if (j<i) continue;
+        b->gstart[b->ngroup++] = n;
+        for (j=i; j<nfib; j++)
+            if (spont[j]==spont[i]) b->order[n++] = &b->fib[j];
+    }
+    b->gstart[b->ngroup] = n;
+    return(AN_OK);
+}
+
+size_t SynapseBankWorkSize(double cf, double tdres, int nfib, double implnt, double sampFreq, long totalstim)
+{
+    return(nfib*SynapseWorkSize(cf, tdres, implnt, sampFreq, totalstim)
+           + ANWorkRound(nfib*sizeof(SYNSTATE)) + ANWorkRound(nfib*sizeof(SYNSTATE*))
+           + ANWorkRound((nfib+1)*sizeof(int)) + ANWorkRound(nfib*sizeof(double*))
+           + ANWorkRound(nfib*sizeof(long)) + ANWorkRound((SYN_NGLANES+SYN_NFLANES)*nfib*sizeof(double)));
+}
+
+long SynapseBankRun(SYNBANK *b, const double *ihcout, long nsamp, double **synout)
+{
+    int j;
+
+    for (j=0; j<b->nfib; j++)
+    {
+        b->out[j] = synout[b->order[j]-b->fib];
+        b->nw[j]  = 0;
+    }
+
+    SynapseRunFibers(b->order, b->gstart, b->ngroup, b->lanes, ihcout, nsamp, b->out, b->nw);
+
+    /* all the fibers are in step, so they have written the same number of samples */
+    return(b->nw[0]);
+}
+
+void SynapseBankFree(SYNBANK *b)
+{
+    int i;
+
+    for (i=0; i<b->nfib; i++)
+        SynapseFree(&b->fib[i]);
+    ANWorkRelease(b->work, b->lanes);  b->lanes  = NULL;
+    ANWorkRelease(b->work, b->nw);     b->nw     = NULL;
+    ANWorkRelease(b->work, b->out);    b->out    = NULL;
+    ANWorkRelease(b->work, b->gstart); b->gstart = NULL;
+    ANWorkRelease(b->work, b->order);  b->order  = NULL;
+    ANWorkRelease(b->work, b->fib);    b->fib    = NULL;
+    b->nfib = 0;
+}
+
+/* -------------------------------------------------------------------------------------------- */
+/* Checkpoints: the fixed part of SYNSTATE is stored as it is, followed by the resampler
+   history, the coarse fGn sequence and (for the actual implementation) the power-law history */
+
+void SynapseSaveState(const SYNSTATE *st, ANBLOB *blob)
+{
+    ANBlobPutHeader(blob, AN_TAG_SYN, sizeof(SYNSTATE));
+    ANBlobPut(blob, st, sizeof(SYNSTATE));
+    ANBlobPut(blob, st->down.buf, 2*st->down.nh*sizeof(double));
+    ANBlobPut(blob, st->fgn.y, st->fgn.ncoarse*sizeof(double));
+    if (st->implnt==1)
+    {
+        ANBlobPut(blob, st->sout1hist, st->k*sizeof(double));
+        ANBlobPut(blob, st->sout2hist, st->k*sizeof(double));
+    }
+}
+
+int SynapseLoadState(SYNSTATE *st, ANBLOB *blob)
+{
+    SYNSTATE saved;
+
+    if (ANBlobCheckHeader(blob, AN_TAG_SYN, sizeof(SYNSTATE))!=AN_OK) return(blob->err);
+    ANBlobGet(blob, &saved, sizeof(SYNSTATE));
+    if (blob->err) return(blob->err);
+
+    /* The checkpoint must come from the same fiber */
+    if (saved.cf!=st->cf || saved.tdres!=st->tdres || saved.spont!=st->spont || saved.noiseType!=st->noiseType
+        || saved.implnt!=st->implnt || saved.sampFreq!=st->sampFreq || saved.totalstim!=st->totalstim || saved.nlow!=st->nlow
+        || saved.down.nh!=st->down.nh || saved.fgn.ncoarse!=st->fgn.ncoarse || saved.k>st->nlow)
+        return(AN_ESTATE);
+
+    saved.down.h    = st->down.h;   saved.down.buf = st->down.buf;
+    saved.fgn.y     = st->fgn.y;    saved.fgn.up   = st->fgn.up;
+    saved.down.work = st->down.work;
+    saved.fgn.work  = st->fgn.work;
+    saved.sout1hist = st->sout1hist;
+    saved.sout2hist = st->sout2hist;
+    saved.work      = st->work;
+    *st = saved;
+    ANBlobGet(blob, st->down.buf, 2*st->down.nh*sizeof(double));
+    ANBlobGet(blob, st->fgn.y, st->fgn.ncoarse*sizeof(double));
+    if (st->implnt==1)
+    {
+        ANBlobGet(blob, st->sout1hist, st->k*sizeof(double));
+        ANBlobGet(blob, st->sout2hist, st->k*sizeof(double));
+    }
+    return(blob->err);
+}
+/* ------------------------------------------------------------------------------------ */
+/* Pass the output of Synapse model through the Spike Generator */
+
+/* The spike generator now uses a method coded up by B. Scott Jackson (bsj22@cornell.edu)
+   Scott's original code is available from Laurel Carney's web site at:
+   http://www.urmc.rochester.edu/smd/Nanat/faculty-research/lab-pages/LaurelCarney/auditory-models.cfm
+*/
+
+void SpikeGeneratorInit(SPKSTATE *sg, double tdres, long totalstim, uint64_t seed, ANWORK *work)
+{
+    memset(sg, 0, sizeof(SPKSTATE));
+    sg->work = work;
+
+    sg->c0      = 0.5;
+    sg->s0      = 0.001;
+    sg->c1      = 0.5;
+    sg->s1      = 0.0125;
+    sg->dead    = 0.00075;
+    sg->tdres   = tdres;
+
+    sg->DT = totalstim * tdres;  /* Total duration of the rate function */
+
+    /* Calculate useful constants */
+    sg->deadtimeIndex = (long) floor(sg->dead/tdres);  /* Integer number of discrete time bins within deadtime */
+    sg->deadtimeRnd = sg->deadtimeIndex*tdres;         /* Deadtime rounded down to length of an integer number of discrete time bins */
+
+    sg->refracMult0 = 1 - tdres/sg->s0;  /* If y0(t) = c0*exp(-t/s0), then y0(t+tdres) = y0(t)*refracMult0 */
+    sg->refracMult1 = 1 - tdres/sg->s1;  /* If y1(t) = c1*exp(-t/s1), then y1(t+tdres) = y1(t)*refracMult1 */
+
+    ANRandSeed(&sg->rng, seed);
+}
+
+long SpikeGeneratorMaxSpikes(const SPKSTATE *sg, long nsamp)
+{
+    return(nsamp/(sg->deadtimeIndex+1)+1);
+}
+
+/* One time bin of the spike generator; returns 1 and writes *sptime and *spindex if a spike occurs */
+static int SpikeStep(SPKSTATE *sg, double synout, double *sptime, long *spindex)
+{
+    double c0 = sg->c0, s0 = sg->s0, c1 = sg->c1, s1 = sg->s1, dead = sg->dead, tdres = sg->tdres;
+    double endOfLastDeadtime;
+    int    spike = 0;
+
+    if (!sg->started)
+    {
+        /* Calculate effects of a random spike before t=0 on refractoriness and the time-warping sum at t=0 */
+        endOfLastDeadtime = __max(0,log(ANRandUniform(&sg->rng)) / synout + dead);  /* End of last deadtime before t=0 */
+        sg->refracValue0 = c0*exp(endOfLastDeadtime/s0);     /* Value of first exponential in refractory function */
+        sg->refracValue1 = c1*exp(endOfLastDeadtime/s1);     /* Value of second exponential in refractory function */
+        sg->Xsum = synout * (-endOfLastDeadtime + c0*s0*(exp(endOfLastDeadtime/s0)-1) + c1*s1*(exp(endOfLastDeadtime/s1)-1));
+            /* Value of time-warping sum */
+            /*  ^^^^ This is the "integral" of the refractory function ^^^^ (normalized by 'tdres') */
+
+        /* Calculate first interspike interval in a homogeneous, unit-rate Poisson process (normalized by 'tdres') */
+        sg->unitRateIntrvl = -log(ANRandUniform(&sg->rng))/tdres;
+            /* NOTE: Both 'unitRateInterval' and 'Xsum' are divided (or normalized) by 'tdres' in order to reduce calculation time.
+            This way we only need to divide by 'tdres' once per spike (when calculating 'unitRateInterval'), instead of
+            multiplying by 'tdres' once per time bin (when calculating the new value of 'Xsum').                         */
+
+        sg->countTime = tdres;
+        sg->started   = 1;
+    }
+
+    if (sg->skip>0)  /* Time bins inside the deadtime of the last spike are skipped */
+    {
+        sg->skip--;
+        sg->k++;
+        return(0);
+    }
+    if (sg->done || !(sg->countTime<sg->DT))
+    {
+        sg->done = 1;
+        sg->k++;
+        return(0);
+    }
+
+    if (synout>0)  /* Nothing to do for non-positive rates, i.e. Xsum += 0 for non-positive rates. */
+    {
+      sg->Xsum += synout*(1 - sg->refracValue0 - sg->refracValue1);  /* Add synout*(refractory value) to time-warping sum */
+
+        if ( sg->Xsum >= sg->unitRateIntrvl )  /* Spike occurs when time-warping sum exceeds interspike "time" in unit-rate process */
+        {
+            if (sptime!=NULL) { *sptime = sg->countTime; *spindex = sg->k; }
+            if (sg->stats!=NULL) SpikeStatsAdd(sg->stats, sg->countTime);
+            spike = 1;
+            sg->unitRateIntrvl = -log(ANRandUniform(&sg->rng)) /tdres;
+             sg->Xsum = 0;
+
+            /* Increase index and time to the last time bin in the deadtime, and reset (relative) refractory function */
+            sg->skip = sg->deadtimeIndex;
+            sg->countTime += sg->deadtimeRnd;
+            sg->refracValue0 = c0;
+            sg->refracValue1 = c1;
+        }
+    }
+    sg->countTime += tdres;
+    sg->refracValue0 *= sg->refracMult0;
+    sg->refracValue1 *= sg->refracMult1;
+    sg->k++;
+    return(spike);
+}
+
+long SpikeGeneratorRun(SPKSTATE *sg, const double *synouttmp, long nsamp, double *sptime, long *spindex)
+{
+    long i, Nout = 0;
+
+    for (i=0; i<nsamp; ++i)  /* Loop through rate vector */
+        Nout += SpikeStep(sg, synouttmp[i], (sptime!=NULL) ? sptime+Nout : NULL, (sptime!=NULL) ? spindex+Nout : NULL);
+
+    return(Nout);  /* Number of spikes that occurred. */
+}
+
+/* Event-driven version: by time rescaling, a spike occurs when the integral of the rate times
+   the refractory function, 1 - refracValue0*refracMult0^j - refracValue1*refracMult1^j, reaches
+   unitRateIntrvl.  The rate is summed over blocks of AN_SPK_BLOCK bins, with and without each
+   exponential weighting, so whole blocks without a spike are crossed with one step; once the
+   refractory exponentials have decayed to nothing, the crossing block is found by binary search
+   of the cumulative integral.  Only the block holding a spike (or the end) is visited bin by bin,
+   so the same spike train is produced (up to rounding) at a cost set by the number of spikes. */
+long SpikeGeneratorRunEvents(SPKSTATE *sg, const double *synout, long nsamp, double *sptime, long *spindex)
+{
+    double *S, *G0, *G1, *CS, pw0[AN_SPK_BLOCK], pw1[AN_SPK_BLOCK], mB0, mB1, r, contrib, tdres = sg->tdres;
+    long   nb, b, i, j, m, lo, hi, mdt, scan, Nout = 0;
+    size_t mark;
+
+    nb   = nsamp/AN_SPK_BLOCK;
+    mark = ANWorkMark(sg->work);
+    S    = (double*)ANWorkAlloc(sg->work,(4*nb+1)*sizeof(double));
+    if (S==NULL) return(SpikeGeneratorRun(sg, synout, nsamp, sptime, spindex));
+    G0 = S+nb; G1 = G0+nb; CS = G1+nb;
+
+    pw0[0] = 1; pw1[0] = 1;
+    for (j=1; j<AN_SPK_BLOCK; j++)
+    {
+        pw0[j] = pw0[j-1]*sg->refracMult0;
+        pw1[j] = pw1[j-1]*sg->refracMult1;
+    }
+    mB0 = pw0[AN_SPK_BLOCK-1]*sg->refracMult0;
+    mB1 = pw1[AN_SPK_BLOCK-1]*sg->refracMult1;
+
+    /* block sums of the (non-negative part of the) rate; CS is their cumulative sum */
+    CS[0] = 0;
+    for (b=0; b<nb; b++)
+    {
+        S[b] = 0; G0[b] = 0; G1[b] = 0;
+        for (j=0; j<AN_SPK_BLOCK; j++)
+        {
+            r = synout[b*AN_SPK_BLOCK+j];
+            if (r<=0) continue;
+            S[b]  += r;
+            G0[b] += r*pw0[j];
+            G1[b] += r*pw1[j];
+        }
+        CS[b+1] = CS[b]+S[b];
+    }
+
+    i = 0; scan = 0;
+    while (i<nsamp)
+    {
+        if (sg->started && sg->skip>0 && !scan)
+        {
+            j = __min(sg->skip, nsamp-i);
+            sg->skip -= j; sg->k += j; i += j;
+            continue;
+        }
+        if (sg->started && sg->done)
+        {
+            sg->k += nsamp-i;
+            break;
+        }
+        b = i/AN_SPK_BLOCK;
+        if (scan || !sg->started || sg->done || (i%AN_SPK_BLOCK) || b>=nb
+            || (1 - sg->refracValue0 - sg->refracValue1)<0)
+        {
+            /* bin by bin: at the start, up to a block boundary, and inside the block holding the next event */
+            if (SpikeStep(sg, synout[i], (sptime!=NULL) ? sptime+Nout : NULL, (sptime!=NULL) ? spindex+Nout : NULL))
+            {
+                Nout++;
+                scan = 0;
+            }
+            else if (scan) scan--;
+            i++;
+            continue;
+        }
+
+        /* whole blocks that end before DT */
+        mdt = (sg->DT>sg->countTime) ? (long)((sg->DT-sg->countTime)/(AN_SPK_BLOCK*tdres)) : 0;
+        mdt = __min(mdt, nb-b);
+
+        if (sg->refracValue0<1e-17 && sg->refracValue1<1e-17)
+        {
+            /* refractoriness has worn off: the largest number of blocks that stays below the threshold */
+            lo = 0; hi = mdt;
+            while (lo<hi)
+            {
+                m = (lo+hi+1)/2;
+                if (sg->Xsum + (CS[b+m]-CS[b]) < sg->unitRateIntrvl) lo = m;
+                else hi = m-1;
+            }
+            m = lo;
+            if (m>0)
+            {
+                sg->Xsum += CS[b+m]-CS[b];
+                sg->refracValue0 *= pow(mB0, (double)m);
+                sg->refracValue1 *= pow(mB1, (double)m);
+            }
+        }
+        else
+        {
+            contrib = S[b] - sg->refracValue0*G0[b] - sg->refracValue1*G1[b];
+            m = (mdt>0 && sg->Xsum + contrib < sg->unitRateIntrvl) ? 1 : 0;
+            if (m>0)
+            {
+                sg->Xsum += contrib;
+                sg->refracValue0 *= mB0;
+                sg->refracValue1 *= mB1;
+            }
+        }
+        if (m==0)
+        {
+            scan = AN_SPK_BLOCK;   /* the event is in this block */
+            continue;
+        }
+        sg->countTime += m*AN_SPK_BLOCK*tdres;
+        sg->k += m*AN_SPK_BLOCK;
+        i += m*AN_SPK_BLOCK;
+    }
+
+    ANWorkRelease(sg->work, S);
+    ANWorkReset(sg->work, mark);
+    return(Nout);
+}
+
+size_t SpikeGeneratorWorkSize(long nsamp)
+{
+    return(ANWorkRound((4*(nsamp/AN_SPK_BLOCK)+1)*sizeof(double)));
+}
+
+void SpikeGeneratorSaveState(const SPKSTATE *sg, ANBLOB *blob)
+{
+    ANBlobPutHeader(blob, AN_TAG_SPK, sizeof(SPKSTATE));
+    ANBlobPut(blob, sg, sizeof(SPKSTATE));
+}
+
+int SpikeGeneratorLoadState(SPKSTATE *sg, ANBLOB *blob)
+{
+    SPKSTATE saved;
+
+    if (ANBlobCheckHeader(blob, AN_TAG_SPK, sizeof(SPKSTATE))!=AN_OK) return(blob->err);
+    ANBlobGet(blob, &saved, sizeof(SPKSTATE));
+    if (blob->err) return(blob->err);
+    if (saved.tdres!=sg->tdres || saved.DT!=sg->DT) return(AN_ESTATE);
+    saved.work  = sg->work;
+    saved.stats = sg->stats;  /* the statistics are not part of the checkpoint */
+    *sg = saved;
+    return(AN_OK);
+}
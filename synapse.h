@@ -0,0 +1,140 @@
+#ifndef _SYNAPSE_H
+#define _SYNAPSE_H
+
+/* SYNAPSE.H header file
+ * IHC-AN synapse (exponential and power-law adaptation) and spike generator sections of the model.
+ * Both run on consecutive segments of their input and keep their complete state in a
+ * SYNSTATE / SPKSTATE, which can be saved in and restored from a checkpoint.
+*/
+
+#include "anmodel.h"
+#include "resample.h"
+#include "ffgn.h"
+#include "powerlaw.h"
+#include "spkstats.h"
+
+typedef struct __SYNSTATE
+{
+    /* model parameters */
+    double cf, tdres, spont, noiseType, implnt, sampFreq;
+    long   totalstim;       /* number of samples in the whole simulation (all repetitions) */
+    int    resamp;          /* decimation factor from 1/tdres to sampFreq */
+    int    delaypoint;      /* padding at each end of the power-law section */
+    long   nlow;            /* number of samples of the power-law section (at sampFreq) */
+    int    fitted;          /* approximate implementation with kernels fitted for sampFreq (not 10 kHz) */
+
+    /* constants of the exponential and power-law adaptation */
+    double synstrength, synslope, CG, PG, PL, VI, VL;
+    double alpha1, beta1, alpha2, beta2, binwidth;
+
+    /* running state */
+    double CI, CL, I1, I2;
+    double expon0, exponlast;               /* first and latest outputs of the exponential adaptation */
+    long   nin;                             /* IHC samples consumed */
+    double ihclast, PPIlast;                 /* latest IHC sample and its release rate */
+    long   nquiet;                          /* IHC samples equal to the one before (silence), whose
+                                               release rate was not recomputed */
+    long   k;                               /* power-law samples computed */
+    long   nout;                            /* synapse output samples produced */
+    double sout1[2], sout2[2];              /* previous two inputs of the power-law filters */
+    double m1[2], m2[2], m3[2], m4[2], m5[2], n1[2], n2[2], n3[2]; /* previous two outputs of each IIR section */
+    double synSampOut[2];                   /* last two power-law outputs, for the upsampling */
+    PLFILTER pl1, pl2;                      /* fitted kernels of beta1 and beta2 */
+    double y1[AN_PL_MAXORDER], y2[AN_PL_MAXORDER]; /* outputs of their sections */
+
+    RESAMPLER down;                         /* decimator to sampFreq (its position is the resampler phase) */
+    FFGN      fgn;                          /* fractional Gaussian noise, indexed by k */
+    double   *sout1hist, *sout2hist;        /* full history, for the actual implementation only */
+    ANWORK   *work;                         /* workspace of the buffers (NULL for the heap) */
+} SYNSTATE;
+
+/* Set up a fiber of spontaneous rate spont (> 0) for a simulation of totalstim samples.  The fGn
+   is generated from the given seed (noiseType 1) or from a fixed seed (noiseType 0).
+   The power-law section runs at 1/(resamp*tdres), with resamp = ceil(1/(tdres*sampFreq));
+   sampFreq 0 selects the standard 10 kHz.  Off 10 kHz the approximate implementation uses
+   kernels fitted for the rate (see powerlaw.h) over the whole simulation, so it then
+   approximates the actual implementation to within AN_PL_TOL.  The buffers are taken from
+   work, which must have SynapseWorkSize bytes free (or NULL for the heap). */
+int  SynapseInit(SYNSTATE *st, double cf, double tdres, double spont, double noiseType, double implnt,
+                 double sampFreq, long totalstim, uint64_t seed, ANWORK *work);
+size_t SynapseWorkSize(double cf, double tdres, double implnt, double sampFreq, long totalstim);
+/* Run the next nsamp samples of the IHC output.  The synapse output lags its input by up to
+   SynapseMaxOutput(st,0) samples; the number of output samples written to synout is returned,
+   and the remainder is written once the last of the totalstim input samples has arrived. */
+long SynapseRun(SYNSTATE *st, const double *ihcout, long nsamp, double *synout);
+/* Size of the synout buffer needed for the next nsamp input samples */
+long SynapseMaxOutput(const SYNSTATE *st, long nsamp);
+/* Upper bound on the lag of the output behind the input (the decimator's group delay and
+   one interpolation interval), so that SynapseMaxOutput(st,n) <= n + SynapseMaxLag(...) */
+long SynapseMaxLag(double tdres, double sampFreq);
+void SynapseFree(SYNSTATE *st);
+
+void SynapseSaveState(const SYNSTATE *st, ANBLOB *blob);
+int  SynapseLoadState(SYNSTATE *st, ANBLOB *blob);
+/* SynapseInit followed by SynapseLoadState, without generating the fGn that the checkpoint
+   replaces (the cost of a segment then does not grow with totalstim); nothing is left set up
+   if either fails */
+int  SynapseInitState(SYNSTATE *st, double cf, double tdres, double spont, double noiseType, double implnt,
+                      double sampFreq, long totalstim, ANBLOB *blob, ANWORK *work);
+
+/* Bank of fibers of one CF driven by the same IHC output, with any spontaneous rates (spikes/s,
+   not restricted to 0.1, 4 and 100).  Fibers of the same spontaneous rate share the softplus,
+   the exponential adaptation and the decimator, and differ only in their fGn (fiber i is seeded
+   with seed+i), so only the power-law section and the upsampling are run per fiber.  All the
+   fibers advance together, sample by sample, with their state held as a structure of arrays
+   (lanes) so that each stage runs as one loop over the groups or the fibers.  Each fiber gives
+   the same output as a SYNSTATE set up with the same arguments. */
+typedef struct __SYNBANK
+{
+    int        nfib, ngroup;
+    SYNSTATE  *fib;         /* the fibers, in the order of their spontaneous rates */
+    SYNSTATE **order;       /* the fibers by group; group g is order[gstart[g]] to order[gstart[g+1]-1] */
+    int       *gstart;
+    double   **out;         /* output rows and counts of SynapseBankRun, in the order of order[] */
+    long      *nw;
+    double    *lanes;       /* the state of the fibers as a structure of arrays, during SynapseBankRun */
+    ANWORK    *work;        /* workspace of the buffers (NULL for the heap) */
+} SYNBANK;
+
+int  SynapseBankInit(SYNBANK *b, double cf, double tdres, const double *spont, int nfib, double noiseType,
+                     double implnt, double sampFreq, long totalstim, uint64_t seed, ANWORK *work);
+size_t SynapseBankWorkSize(double cf, double tdres, int nfib, double implnt, double sampFreq, long totalstim);
+/* Run the next nsamp samples of the IHC output; the output of fiber i is written to synout[i]
+   (SynapseMaxOutput(&b->fib[0],nsamp) samples at most), and the number of samples written per
+   fiber is returned, as for SynapseRun */
+long SynapseBankRun(SYNBANK *b, const double *ihcout, long nsamp, double **synout);
+void SynapseBankFree(SYNBANK *b);
+
+/* Spike generator (renewal process with refractoriness, by B. Scott Jackson) */
+#define AN_SPK_BLOCK 64     /* bins per block of the event-driven spike generator */
+typedef struct __SPKSTATE
+{
+    double tdres, DT, c0, s0, c1, s1, dead, deadtimeRnd, refracMult0, refracMult1;
+    long   deadtimeIndex;
+    long   k;               /* index of the next rate sample */
+    long   skip;            /* rate samples still to skip in the current deadtime */
+    int    started, done;
+    double refracValue0, refracValue1, Xsum, unitRateIntrvl, countTime;
+    ANRAND rng;
+    ANWORK *work;           /* workspace of the block sums of SpikeGeneratorRunEvents (NULL for the heap) */
+    SPKSTATS *stats;        /* statistics updated with each spike (NULL, as set by SpikeGeneratorInit, for none) */
+} SPKSTATE;
+
+void SpikeGeneratorInit(SPKSTATE *sg, double tdres, long totalstim, uint64_t seed, ANWORK *work);
+/* Run the next nsamp samples of the synapse output; writes the spike times and the indices
+   of the samples in which they occurred, and returns the number of spikes.  sptime and
+   spindex may be NULL when only sg->stats is wanted. */
+long SpikeGeneratorRun(SPKSTATE *sg, const double *synout, long nsamp, double *sptime, long *spindex);
+/* Same, event-driven: whole blocks of bins without a spike are crossed in one step, so the
+   cost depends on the number of spikes rather than the number of samples.  The state is the
+   same as for SpikeGeneratorRun, and the two can be mixed.  The block sums take
+   SpikeGeneratorWorkSize(nsamp) bytes of the workspace for the duration of the call. */
+long SpikeGeneratorRunEvents(SPKSTATE *sg, const double *synout, long nsamp, double *sptime, long *spindex);
+size_t SpikeGeneratorWorkSize(long nsamp);
+/* Upper bound on the number of spikes in the next nsamp samples */
+long SpikeGeneratorMaxSpikes(const SPKSTATE *sg, long nsamp);
+
+void SpikeGeneratorSaveState(const SPKSTATE *sg, ANBLOB *blob);
+int  SpikeGeneratorLoadState(SPKSTATE *sg, ANBLOB *blob);
+
+#endif
@@ -0,0 +1,34 @@
+% check of the fixed C1 filter run for fibers with completely impaired OHCs
+%
+% With cohc = 0 model_IHC skips the control path and runs C1 as a fixed filter.
+% With cohc = realmin the time constant of C1 rounds to the same value, but the
+% full path runs, so the two must agree to rounding.
+clear all;
+Fs   = 100e3;  % sampling rate in Hz
+T    = 50e-3;  % stimulus duration in seconds
+rt   = 2.5e-3; % rise/fall time in seconds
+tol  = 1e-12;  % largest difference allowed, relative to the largest output
+cihc = [1.0 0.3];
+
+t = 0:1/Fs:T-1/Fs;
+mxpts = length(t);
+irpts = rt*Fs;
+
+for species = 1:3
+    for CF = [250 1000 4000 12000]
+        for stimdb = [20 65 100]
+            pin = sqrt(2)*20e-6*10^(stimdb/20)*sin(2*pi*CF*t);
+            pin(1:irpts)= pin(1:irpts).*(0:(irpts-1))/irpts;
+            pin((mxpts-irpts):mxpts)=pin((mxpts-irpts):mxpts).*(irpts:-1:0)/irpts;
+
+            vfixed = model_IHC(pin,CF,1,1/Fs,T*2,0,cihc,species);
+            vfull  = model_IHC(pin,CF,1,1/Fs,T*2,realmin,cihc,species);
+            err = max(abs(vfixed(:)-vfull(:)))/max(abs(vfull(:)));
+            if err>tol
+                error('species %d, CF %g Hz, %g dB SPL: the fixed C1 differs by %g (relative)', ...
+                      species, CF, stimdb, err);
+            end
+        end
+    end
+end
+disp('testOHCImpaired: the fixed C1 agrees with the full run');
@@ -0,0 +1,238 @@
+/*
+threshold.c finds the thresholds of model fibers by bisection on the level of a tone
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+#include "anmodel.h"
+#include "ihcan.h"
+#include "synapse.h"
+#include "population.h"
+#include "shard.h"
+#include "threshold.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef NAN
+#define NAN (0.0/0.0)
+#endif
+
+#define AN_THR_MAXRATE (1/0.75e-3)  /* bound on the mean rate with refractoriness */
+
+typedef struct __THRPLAN
+{
+    IHCSTATE st;
+    SYNSTATE syn;
+    ANBLOB   init;      /* the states as set up, restored before each level */
+    long     nsamp;
+    double  *px, *ihcout, *synout;
+} THRPLAN;
+
+int ANThrCheck(const ANTHRSPEC *spec)
+{
+    long i;
+
+    /* as ANPopCheck, the tests are written so that a NaN fails them */
+    if (!(spec->tdres>0) || !(spec->dur>0) || !(spec->ramp>=0 && 2*spec->ramp<=spec->dur)) return(AN_EPARAM);
+    if (!(spec->criterion>0) || !(spec->tol>0) || !(spec->hi>=spec->lo) || spec->npts<1) return(AN_EPARAM);
+    if (spec->species<1 || spec->species>3 || spec->fibertype<1 || spec->fibertype>3) return(AN_EPARAM);
+    if ((spec->noiseType!=0 && spec->noiseType!=1) || (spec->implnt!=0 && spec->implnt!=1)) return(AN_EPARAM);
+    if (!(spec->synrate>=0) && spec->synrate!=AN_SYNRATE_AUTO) return(AN_EPARAM);
+    for (i=0; i<spec->npts; i++)
+    {
+        if (!(spec->pts[i].cf>=124.9 && spec->pts[i].cf<=((spec->species==1) ? 40.1e3 : 20.1e3))) return(AN_EPARAM);
+        if (!(spec->pts[i].freq>0 && spec->pts[i].freq<0.5/spec->tdres)) return(AN_EPARAM);
+        if (!(spec->pts[i].cohc>=0 && spec->pts[i].cohc<=1) || !(spec->pts[i].cihc>=0 && spec->pts[i].cihc<=1))
+            return(AN_EPARAM);
+    }
+    return(AN_OK);
+}
+
+/* The rate of the synapse section (ANPopSynRate, which only needs these fields) */
+static double ThrSynRate(const ANTHRSPEC *spec, double cf)
+{
+    ANPOPSPEC pop;
+
+    memset(&pop, 0, sizeof(pop));
+    pop.synrate = spec->synrate;
+    return(ANPopSynRate(&pop, cf));
+}
+
+static long ThrSamples(const ANTHRSPEC *spec)
+{
+    return((long)floor(spec->dur/spec->tdres+0.5));
+}
+
+size_t ANThrWorkSize(const ANTHRSPEC *spec, long i)
+{
+    double cf = spec->pts[i].cf;
+    long   nsamp = ThrSamples(spec);
+
+    return(IHCANWorkSize(cf, spec->tdres, spec->species, 0)
+           + SynapseWorkSize(cf, spec->tdres, spec->implnt, ThrSynRate(spec, cf), nsamp)
+           + 2*ANWorkRound(AN_POP_CHUNK*sizeof(double))
+           + ANWorkRound((AN_POP_CHUNK + SynapseMaxLag(spec->tdres, ThrSynRate(spec, cf)))*sizeof(double)));
+}
+
+/* Mean rate over the tone at level db (silence if db is -HUGE_VAL).  The run stops as soon as
+   the rate is known to be at least target (*above = 1) or below it (*above = 0). */
+static int ThrRate(const ANTHRSPEC *spec, const ANTHRPOINT *pt, THRPLAN *plan, double db, double target,
+                   double *rate, int *above)
+{
+    double amp, sum = 0, t;
+    long   nin, nout = 0, n, nsyn, i, irpts, nsamp = plan->nsamp;
+    int    err;
+    ANBLOB blob;
+
+    ANBlobWrap(&blob, plan->init.data, plan->init.size);
+    if ((err = IHCANLoadState(&plan->st, &blob)) != AN_OK) return(err);
+    if ((err = SynapseLoadState(&plan->syn, &blob)) != AN_OK) return(err);
+
+    amp   = (db==-HUGE_VAL) ? 0 : sqrt(2)*20e-6*pow(10, db/20);
+    irpts = (long)floor(spec->ramp/spec->tdres+0.5);
+    *above = -1;
+    for (nin=0; nin<nsamp && *above<0; nin+=n)
+    {
+        n = __min(AN_POP_CHUNK, nsamp-nin);
+        for (i=0; i<n; i++)
+        {
+            t = (nin+i)*spec->tdres;
+            plan->px[i] = amp*sin(TWOPI*pt->freq*t);
+            if (irpts==0) continue;   /* no ramp */
+            if (nin+i<irpts)              plan->px[i] *= (double)(nin+i)/irpts;
+            else if (nin+i>=nsamp-1-irpts) plan->px[i] *= (double)(nsamp-1-(nin+i))/irpts;
+        }
+        if ((err = IHCANRun(&plan->st, plan->px, n, plan->ihcout)) != AN_OK) return(err);
+        nsyn = SynapseRun(&plan->syn, plan->ihcout, n, plan->synout);
+        ANPopProduct(AN_PROD_MEANRATE, NULL, plan->synout, nsyn, nout, NULL, NULL);
+        for (i=0; i<nsyn; i++) sum += plan->synout[i];
+        nout += nsyn;
+
+        /* the rate is never negative nor above AN_THR_MAXRATE */
+        if (target>0 && sum>=target*nsamp)                                  *above = 1;
+        if (target>0 && sum+(nsamp-nout)*AN_THR_MAXRATE<target*nsamp)       *above = 0;
+    }
+    *rate = sum/nsamp;
+    if (*above<0) *above = (*rate>=target);
+    return(AN_OK);
+}
+
+int ANThrSearch(const ANTHRSPEC *spec, long i, ANWORK *work, ANTHRRESULT *res)
+{
+    const ANTHRPOINT *pt = spec->pts + i;
+    double   rate, lo, hi, mid, target;
+    int      err, above;
+    size_t   mark = ANWorkMark(work);
+    THRPLAN  plan;
+
+    res->thr = 0; res->spont = 0; res->nsim = 0;
+    plan.nsamp  = ThrSamples(spec);
+    plan.px     = (double*)ANWorkAlloc(work, AN_POP_CHUNK*sizeof(double));
+    plan.ihcout = (double*)ANWorkAlloc(work, AN_POP_CHUNK*sizeof(double));
+    plan.synout = (double*)ANWorkAlloc(work, (AN_POP_CHUNK + SynapseMaxLag(spec->tdres, ThrSynRate(spec, pt->cf)))*sizeof(double));
+    if (plan.px==NULL || plan.ihcout==NULL || plan.synout==NULL)
+    {
+        ANWorkRelease(work, plan.px); ANWorkRelease(work, plan.ihcout); ANWorkRelease(work, plan.synout);
+        ANWorkReset(work, mark);
+        return(AN_ENOMEM);
+    }
+
+    /* the fiber is set up once; the IHC output is not delayed, so that the rate is measured
+       over the response to the tone */
+    err = IHCANInit(&plan.st, pt->cf, spec->tdres, pt->cohc, pt->cihc, spec->species, 0, work);
+    if (err==AN_OK)
+    {
+        err = SynapseInit(&plan.syn, pt->cf, spec->tdres, ANPopSpont(spec->fibertype), spec->noiseType, spec->implnt,
+                          ThrSynRate(spec, pt->cf), plan.nsamp, spec->seed + (uint64_t)i, work);
+        if (err!=AN_OK) IHCANFree(&plan.st);
+    }
+    if (err==AN_OK)
+    {
+        ANBlobInit(&plan.init);
+        IHCANSaveState(&plan.st, &plan.init);
+        SynapseSaveState(&plan.syn, &plan.init);
+        if (plan.init.err) err = plan.init.err;
+
+        /* spontaneous rate, then bisection; the levels share the fGn, so the rate is
+           a smooth function of the level */
+        if (err==AN_OK) err = ThrRate(spec, pt, &plan, -HUGE_VAL, 0, &res->spont, &above);
+        res->nsim = 1;
+        target = res->spont + spec->criterion;
+        lo = spec->lo; hi = spec->hi;
+        if (err==AN_OK) { err = ThrRate(spec, pt, &plan, hi, target, &rate, &above); res->nsim++; }
+        if (err==AN_OK && !above) res->thr = NAN;
+        if (err==AN_OK && above)  { err = ThrRate(spec, pt, &plan, lo, target, &rate, &above); res->nsim++; }
+        if (err==AN_OK && above)  res->thr = lo;
+        if (err==AN_OK && !above && res->thr==0)
+        {
+            while (hi-lo>spec->tol && err==AN_OK)
+            {
+                mid = (lo+hi)/2;
+                err = ThrRate(spec, pt, &plan, mid, target, &rate, &above);
+                res->nsim++;
+                if (above) hi = mid; else lo = mid;
+            }
+            res->thr = hi;
+        }
+        ANBlobFree(&plan.init);
+        SynapseFree(&plan.syn);
+        IHCANFree(&plan.st);
+    }
+    ANWorkRelease(work, plan.px); ANWorkRelease(work, plan.ihcout); ANWorkRelease(work, plan.synout);
+    ANWorkReset(work, mark);
+    return(err);
+}
+
+/* Bound on the heap taken by the checkpoint of point i (THRPLAN.init): the states and buffers it
+   saves are within its workspace, and ANBlobPut at most doubles what it needs */
+static size_t ThrBlobBytes(const ANTHRSPEC *spec, long i)
+{
+    return(2*(sizeof(IHCSTATE) + sizeof(SYNSTATE) + 64 + ANThrWorkSize(spec, i)) + 256);
+}
+
+/* The items of a search are its points; the results go to the shared output as 3 doubles each */
+static int ThrItem(const void *ctx, ANSHARED *sh, long item, ANWORK *work, struct __ANPIPE *pipe)
+{
+    (void)pipe;
+    return(ANThrSearch((const ANTHRSPEC*)ctx, item, work, (ANTHRRESULT*)sh->out.data + item));
+}
+
+int ANThrRun(const ANTHRSPEC *spec, const ANSHARDOPT *opt, ANTHRRESULT *res)
+{
+    ANSHARDJOB  job;
+    ANSHARDOPT  o = *opt;
+    ANSHARED    sh;
+    ANSIGNAL    stim, out;
+    ANTHRRESULT *shres;
+    size_t      size;
+    long        i;
+    int         err;
+
+    if ((err = ANThrCheck(spec)) != AN_OK) return(err);
+
+    size  = spec->npts*sizeof(ANTHRRESULT);
+    shres = (ANTHRRESULT*)mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (shres==(ANTHRRESULT*)MAP_FAILED) return(AN_ENOMEM);
+    stim.data = NULL;  stim.fmt = AN_FLOAT64;    /* the stimuli are generated by the workers */
+    out.data  = shres; out.fmt  = AN_FLOAT64;
+    if ((err = ANSharedCreate(&sh, spec->npts, 3, &stim, &out)) != AN_OK) { munmap(shres, size); return(err); }
+
+    job.run  = ThrItem;
+    job.ctx  = spec;
+    for (job.worksize=0, job.peak=0, i=0; i<spec->npts; i++)
+    {
+        job.worksize = __max(job.worksize, ANThrWorkSize(spec, i));
+        job.peak     = __max(job.peak, ThrBlobBytes(spec, i));
+    }
+    job.peak += job.worksize + sizeof(THRPLAN);
+    o.pipeline = 0;
+    err = ANShardRunJob(&job, &sh, &o);
+
+    memcpy(res, shres, size);
+    ANSharedFree(&sh);
+    munmap(shres, size);
+    return(err);
+}
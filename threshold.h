@@ -0,0 +1,48 @@
+#ifndef _THRESHOLD_H
+#define _THRESHOLD_H
+
+/* THRESHOLD.H header file
+ * adaptive threshold searches (as for the THRESHOLD_ALL_*.mat tables and iso-rate tuning
+ * curves): the threshold of a point (CF, tone frequency, cohc, cihc) is the lowest level of
+ * a tone at which the mean rate (incl. refractoriness) exceeds the spontaneous rate by the
+ * criterion, found by bisection.  Each point sets its fiber up once and restores that state
+ * for every level, so the fGn is generated once per point, and a level is abandoned as soon
+ * as its rate is known to be above or below the target.
+*/
+
+#include "anmodel.h"
+#include "shard.h"
+
+typedef struct __ANTHRPOINT
+{
+    double cf, freq, cohc, cihc;
+} ANTHRPOINT;
+
+typedef struct __ANTHRSPEC
+{
+    double tdres, noiseType, implnt, synrate;
+    int    species, fibertype;
+    uint64_t seed;              /* seed of the fGn of point i is seed + i */
+    double dur, ramp;           /* tone duration and linear rise/fall time (s), as in testANModel.m */
+    double criterion;           /* rate above spont that defines threshold (spikes/s) */
+    double lo, hi, tol;         /* search range and resolution (dB SPL) */
+    long   npts;
+    const ANTHRPOINT *pts;
+} ANTHRSPEC;
+
+/* Result of a point: the threshold (the upper end of the final bracket; lo if the rate is
+   already above the target at lo, NaN if it is not above it at hi), the spontaneous rate and
+   the number of simulations run (the last two as doubles, so that a point is 3 doubles) */
+typedef struct __ANTHRRESULT
+{
+    double thr, spont, nsim;
+} ANTHRRESULT;
+
+int    ANThrCheck(const ANTHRSPEC *spec);
+/* Workspace taken by ANThrSearch for point i */
+size_t ANThrWorkSize(const ANTHRSPEC *spec, long i);
+int    ANThrSearch(const ANTHRSPEC *spec, long i, ANWORK *work, ANTHRRESULT *res);
+/* Search all the points in opt->nworkers processes (see shard.h); res has spec->npts entries */
+int    ANThrRun(const ANTHRSPEC *spec, const ANSHARDOPT *opt, ANTHRRESULT *res);
+
+#endif